@@ -1,7 +1,55 @@
 #include <chrono>
+#include <cstring>
 #include "src/include/html_parser.hpp"
+#include "src/include/corpus_runner.hpp"
+
+/**
+ * @brief print usage of the executable.
+ * @param name name of the executable
+ * @returns exit code
+ */
+int usage(const char *name) {
+  std::cerr << "Usage: " << name << " path/to/file.html\n"
+            << "       " << name << " --corpus <directory|file list> [--threads N] [--readers N]\n"
+            << "            [--prefetch N] [--output stats|text|html] [--unordered]\n";
+  return 1;
+}
 
 int main (int argc, char **argv) {
+  if (argc < 2) {
+    return usage(argv[0]);
+  }
+  if (strcmp(argv[1], "--corpus") == 0) {
+    if (argc < 3) {
+      return usage(argv[0]);
+    }
+    corpus_runner runner(argv[2]);
+    for (int i = 3; i < argc; ++i) {
+      const bool has_value = i + 1 < argc;
+      if (strcmp(argv[i], "--threads") == 0 && has_value) {
+        runner.parser_threads = std::max(1, atoi(argv[++i]));
+      } else if (strcmp(argv[i], "--readers") == 0 && has_value) {
+        runner.reader_threads = std::max(1, atoi(argv[++i]));
+      } else if (strcmp(argv[i], "--prefetch") == 0 && has_value) {
+        runner.prefetch_depth = std::max(1, atoi(argv[++i]));
+      } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+        ++i;
+        if (strcmp(argv[i], "text") == 0) {
+          runner.output = corpus_runner::output_mode::text;
+        } else if (strcmp(argv[i], "html") == 0) {
+          runner.output = corpus_runner::output_mode::html;
+        } else {
+          runner.output = corpus_runner::output_mode::stats;
+        }
+      } else if (strcmp(argv[i], "--unordered") == 0) {
+        runner.ordered = false;
+      } else {
+        return usage(argv[0]);
+      }
+    }
+    return runner.run() ? 2 : 0;
+  }
+
   std::chrono::time_point<std::chrono::system_clock> start, end;
   std::chrono::duration<double> time;
   start = std::chrono::system_clock::now();
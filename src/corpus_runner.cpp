@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "include/corpus_runner.hpp"
+#include "include/html_parser.hpp"
+
+corpus_runner::corpus_runner(const std::string &source):
+  parser_threads(std::max(1U, std::thread::hardware_concurrency())),
+  reader_threads(2), prefetch_depth(64), output(output_mode::stats), ordered(true) {
+  struct stat sb;
+  if (stat(source.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode)) {
+    collect_directory(source);
+    std::sort(paths.begin(), paths.end());
+  } else {
+    std::ifstream list(source);
+    std::string line;
+    while (std::getline(list, line)) {
+      if (line.size()) paths.push_back(line);
+    }
+  }
+}
+
+void corpus_runner::collect_directory(const std::string &dir) {
+  DIR *d = opendir(dir.c_str());
+  if (!d) return;
+  while (struct dirent *entry = readdir(d)) {
+    const std::string name = entry->d_name;
+    if (name == "." || name == "..") continue;
+    const std::string path = dir + "/" + name;
+    struct stat sb;
+    if (stat(path.c_str(), &sb) != 0) continue;
+    if (S_ISDIR(sb.st_mode)) {
+      collect_directory(path);
+    } else if (S_ISREG(sb.st_mode)) {
+      paths.push_back(path);
+    }
+  }
+  closedir(d);
+}
+
+size_t corpus_runner::run() {
+  const size_t total = paths.size();
+  std::vector<double> latency(total, 0.0);
+  std::vector<size_t> bytes(total, 0);
+  std::vector<char> failed(total, false);
+  std::vector<std::string> outputs(ordered ? total : 0);
+
+  // files prefetched by the readers, waiting for a parser.
+  std::deque<size_t> ready;
+  size_t readers_done = 0;
+  std::mutex ready_lock;
+  std::condition_variable ready_cv, space_cv;
+  std::atomic<size_t> next_read(0);
+
+  // ordered output: index of the next output to write.
+  size_t next_write = 0;
+  std::vector<bool> finished(ordered ? total : 0, false);
+  std::mutex write_lock;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  auto read_worker = [&]() {
+    size_t idx;
+    while ((idx = next_read++) < total) {
+      {
+        std::unique_lock<std::mutex> lock(ready_lock);
+        space_cv.wait(lock, [&]() { return ready.size() < prefetch_depth; });
+      }
+      const int fd = open(paths[idx].c_str(), O_RDONLY);
+      if (fd < 0) {
+        failed[idx] = true;
+      } else {
+        struct stat sb;
+        if (fstat(fd, &sb) == 0) {
+          bytes[idx] = sb.st_size;
+          // pull the file into the page cache before a parser asks for it.
+          posix_fadvise(fd, 0, sb.st_size, POSIX_FADV_WILLNEED);
+#ifdef __linux__
+          readahead(fd, 0, sb.st_size);
+#endif
+        }
+        close(fd);
+      }
+      std::lock_guard<std::mutex> lock(ready_lock);
+      ready.push_back(idx);
+      ready_cv.notify_one();
+    }
+    std::lock_guard<std::mutex> lock(ready_lock);
+    ++readers_done;
+    ready_cv.notify_all();
+  };
+
+  auto write_output = [&](const size_t idx, std::string &out) {
+    std::lock_guard<std::mutex> lock(write_lock);
+    if (!ordered) {
+      std::cout << out;
+      return;
+    }
+    outputs[idx].swap(out);
+    finished[idx] = true;
+    // flush every output that is now in order.
+    while (next_write < total && finished[next_write]) {
+      std::cout << outputs[next_write];
+      std::string().swap(outputs[next_write]);
+      ++next_write;
+    }
+  };
+
+  auto parse_worker = [&]() {
+    html_parser parser;
+    std::string out;
+    while (true) {
+      size_t idx;
+      {
+        std::unique_lock<std::mutex> lock(ready_lock);
+        ready_cv.wait(lock, [&]() { return ready.size() || readers_done == reader_threads; });
+        if (ready.empty()) break;
+        idx = ready.front();
+        ready.pop_front();
+        space_cv.notify_one();
+      }
+      out.clear();
+      if (!failed[idx]) {
+        const auto begin = std::chrono::steady_clock::now();
+        dom_element *document = parser.parse_html(paths[idx].c_str());
+        latency[idx] = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        switch (output) {
+          case output_mode::text:
+            out = document->innerText();
+            out.push_back('\n');
+            break;
+          case output_mode::html:
+            out = document->innerHTML();
+            out.push_back('\n');
+            break;
+          default:
+            out = paths[idx] + '\t' + std::to_string(bytes[idx]) + '\t' + std::to_string(latency[idx] * 1000) + "ms\t" +
+                  std::to_string(parser.memory_report().total()) + " bytes held\n";
+            break;
+        }
+      } else {
+        std::cerr << "Error while reading file " << paths[idx] << '\n';
+      }
+      write_output(idx, out);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < reader_threads; ++i) threads.emplace_back(read_worker);
+  for (unsigned i = 0; i < parser_threads; ++i) threads.emplace_back(parse_worker);
+  for (auto &x: threads) x.join();
+  std::cout.flush();
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  size_t total_bytes = 0, errors = 0;
+  std::vector<double> sorted;
+  for (size_t i = 0; i < total; ++i) {
+    if (failed[i]) {
+      ++errors;
+      continue;
+    }
+    total_bytes += bytes[i];
+    sorted.push_back(latency[i]);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted](const double p) {
+    if (sorted.empty()) return 0.0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))] * 1000;
+  };
+  std::cerr << "Files: " << sorted.size() << " parsed, " << errors << " failed\n";
+  std::cerr << "Time: " << elapsed << "s, " << (total_bytes / elapsed / (1 << 20)) << " MB/s, "
+            << (sorted.size() / elapsed) << " files/s\n";
+  std::cerr << "Latency: p50 " << percentile(0.5) << "ms, p90 " << percentile(0.9)
+            << "ms, p99 " << percentile(0.99) << "ms, max " << percentile(1.0) << "ms\n";
+  return errors;
+}
@@ -1,11 +1,35 @@
 #include "include/dom_element.hpp"
+#include "include/html_parser.hpp"
+#include "include/thread_pool.hpp"
+#include <algorithm>
 #include <iostream>
-dom_element::dom_element(dom_element *parent): parent(parent), is_comment(false) { }
+dom_element::dom_element(dom_element *parent): 
+  is_text_node(false), is_comment(false), is_non_terminating(false),
+  is_head(false), is_body(false), space_before(false), space_after(false), parent(parent), source_begin(0), source_length(0), content_begin(0),
+  order_root(nullptr), order_begin(0), order_end(0) { }
 
-void dom_element::__construct_innerHTML(std::string &buffop, const uint16_t depth) {
+void dom_element::reset(dom_element *parent) {
+  child_nodes.clear();
+  children.clear();
+  is_text_node = is_comment = is_non_terminating = is_head = is_body = space_before = space_after = false;
+  tag.clear();
+  innertext.clear();
+  class_list.clear();
+  id.clear();
+  _class.clear();
+  attr.clear();
+  this->parent = parent;
+  source_begin = source_length = content_begin = 0;
+  order_begin = order_end = 0;
+  order_root = nullptr;
+}
+
+void dom_element::__construct_innerHTML(std::string &buffop, const uint16_t depth) const {
   if (!parent) {
     for (auto &x: child_nodes) {
+      if (x->space_before) buffop.push_back(' ');
       x->__construct_innerHTML(buffop, depth + 1);
+      if (x->space_after) buffop.push_back(' ');
     }
     return;
   }
@@ -40,15 +64,25 @@ void dom_element::__construct_innerHTML(std::string &buffop, const uint16_t dept
   }
   buffop.push_back('>');
   for (auto &x: child_nodes) {
+    if (x->space_before) buffop.push_back(' ');
     x->__construct_innerHTML(buffop, depth + 1);
+    if (x->space_after) buffop.push_back(' ');
   }
   buffop += "</";
   buffop += tag;
   buffop.push_back('>');
 }
 
-std::string dom_element::get_attribute_value(const std::string &attribute_name) {
-  const std::unordered_map<std::string, std::string>::iterator iter = attr.find(attribute_name);
+uint64_t dom_element::get_source_offset() const {
+  uint64_t offset = 0;
+  for (const dom_element *x = this; x; x = x->parent) {
+    offset += x->source_begin;
+  }
+  return offset;
+}
+
+std::string dom_element::get_attribute_value(const std::string &attribute_name) const {
+  const std::unordered_map<std::string, std::string>::const_iterator iter = attr.find(attribute_name);
   if (iter != attr.end()) {
     return iter->second;
   }
@@ -135,12 +169,74 @@ dom_element *dom_element::delete_dom_from_document(dom_element *input) {
         child_nodes[j - 1] = child_nodes[j];
       }
       child_nodes.pop_back();
+      // the rest of the tree keeps its positions, the removed subtree gets its own.
+      dom_reference->number_subtree();
       return dom_reference;
     }
   }
   return nullptr;
 }
 
+void dom_element::number_subtree() {
+  uint32_t next = 0;
+  // iterative, so that deep documents do not overflow the stack.
+  std::vector<std::pair<dom_element *, size_t>> stack;
+  stack.emplace_back(this, 0);
+  order_begin = next++;
+  while (stack.size()) {
+    auto &top = stack.back();
+    if (top.second == top.first->child_nodes.size()) {
+      top.first->order_end = next;
+      stack.pop_back();
+      continue;
+    }
+    dom_element *x = top.first->child_nodes[top.second++];
+    x->order_begin = next++;
+    x->order_root = this;
+    stack.emplace_back(x, 0);
+  }
+  order_root = this;
+}
+
+uint8_t dom_element::compare_document_position(const dom_element *other) const {
+  if (other == this) {
+    return 0;
+  }
+  const bool before = document_order(other, this);
+  if (order_root != other->order_root) {
+    return position_disconnected | position_implementation_specific | (before ? position_preceding : position_following);
+  }
+  if (before) {
+    return other->contains(this) ? position_contains | position_preceding : position_preceding;
+  }
+  return contains(other) ? position_contained_by | position_following : position_following;
+}
+
+void dom_element::sort_in_document_order(std::vector<dom_element *> &nodes) {
+  std::sort(nodes.begin(), nodes.end(), document_order);
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+}
+
+std::vector<dom_element *> dom_element::merge_in_document_order(const std::vector<dom_element *> &a,
+  const std::vector<dom_element *> &b) {
+  std::vector<dom_element *> dom;
+  dom.reserve(a.size() + b.size());
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i] == b[j]) {
+      dom.push_back(a[i++]);
+      ++j;
+    } else if (document_order(a[i], b[j])) {
+      dom.push_back(a[i++]);
+    } else {
+      dom.push_back(b[j++]);
+    }
+  }
+  dom.insert(dom.end(), a.begin() + i, a.end());
+  dom.insert(dom.end(), b.begin() + j, b.end());
+  return dom;
+}
+
 std::vector<dom_element *> dom_element::get_elements_by_tag_name(const std::string &tagname) const {
   std::vector<dom_element *> dom;
   for (const auto &x: children) {
@@ -158,25 +254,405 @@ std::vector<dom_element *> dom_element::get_elements_by_tag_name(const std::stri
   return dom;
 }
 
-std::string dom_element::innerText() {
+template <typename match_type>
+void dom_element::collect(const match_type &match, const bool prune, std::vector<dom_element *> &dom) const {
+  for (const auto &x: children) {
+    if (match(*x)) {
+      dom.push_back(x);
+      if (prune) continue;
+    }
+    x->collect(match, prune, dom);
+  }
+}
+
+template <typename match_type>
+void dom_element::split_query(const match_type &match, const bool prune, const uint16_t depth, std::vector<query_task> &tasks) const {
+  for (const auto &x: children) {
+    tasks.push_back(query_task{ x, false });
+    if (x->children.empty() || (prune && match(*x))) continue;
+    if (depth == 0) {
+      tasks.push_back(query_task{ x, true });
+    } else {
+      x->split_query(match, prune, depth - 1, tasks);
+    }
+  }
+}
+
+template <typename match_type>
+std::vector<dom_element *> dom_element::run_query(const match_type &match, const bool prune, const execution_policy &policy) const {
+  std::vector<dom_element *> dom;
+  const size_t wanted = policy.task_count();
+  if (wanted <= 1) {
+    collect(match, prune, dom);
+    return dom;
+  }
+  // documents are narrow at the top (html, body, a wrapper div...): split
+  // one level deeper until there are enough subtrees to balance the pool.
+  std::vector<query_task> tasks;
+  size_t subtrees = 0, previous = SIZE_MAX;
+  for (uint16_t depth = 0; depth < 64; ++depth) {
+    tasks.clear();
+    split_query(match, prune, depth, tasks);
+    subtrees = 0;
+    for (auto &x: tasks) subtrees += x.below;
+    if (subtrees >= wanted || subtrees == previous) break;
+    previous = subtrees;
+  }
+  std::vector<std::vector<dom_element *>> results(tasks.size());
+  policy.pool->parallel_for(tasks.size(), [&](const size_t i) {
+    const query_task &task = tasks[i];
+    if (task.below) {
+      task.node->collect(match, prune, results[i]);
+    } else if (match(*task.node)) {
+      results[i].push_back(const_cast<dom_element *>(task.node));
+    }
+  });
+  size_t total = 0;
+  for (auto &x: results) total += x.size();
+  dom.reserve(total);
+  for (auto &x: results) dom.insert(dom.end(), x.begin(), x.end());
+  return dom;
+}
+
+std::vector<dom_element *> dom_element::get_elements_by_tag_name(const std::string &tagname, const execution_policy &policy) const {
+  return run_query([&tagname](const dom_element &x) { return x.tag == tagname; }, false, policy);
+}
+
+std::vector<dom_element *> dom_element::get_elements_by_class_name(const std::string &classname, const execution_policy &policy) const {
+  return run_query([&classname](const dom_element &x) { return x.has_classname(classname); }, true, policy);
+}
+
+std::vector<dom_element *> dom_element::get_elements_if(const std::function<bool(const dom_element &)> &predicate,
+  const execution_policy &policy) const {
+  return run_query(predicate, false, policy);
+}
+
+std::string dom_element::innerText() const {
   // Return if text is a node.
   if (is_text_node) {
     return innertext;
   }
-  // Parse DOM list and return inner text.
   std::string value = "";
+  append_innerText(value);
+  return value;
+}
+
+void dom_element::append_innerText(std::string &buffop) const {
+  if (is_text_node) {
+    buffop += innertext;
+    return;
+  }
+  // Parse DOM list and append inner text, a dropped whitespace run as one space.
   for (const auto &x: child_nodes) {
-    value += x->innerText();
+    if (x->space_before) buffop.push_back(' ');
+    x->append_innerText(buffop);
+    if (x->space_after) buffop.push_back(' ');
   }
-  return value;
 }
 
-std::string dom_element::innerHTML() {
+std::string dom_element::innerHTML() const {
   std::string output = "";
   __construct_innerHTML(output, 0);
   return output;
 }
 
+static inline bool is_html_whitespace(const char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f'; }
+static inline char lowercase(const char c) { return (c >= 'A' && c <= 'Z') ? (c | 32) : c; }
+
+/**
+ * @brief check whether a string starts with a lowercase prefix, ignoring case.
+ * @param s string to check
+ * @param prefix lowercase prefix
+ * @returns true if it does
+ */
+static bool starts_with_lowercase(const std::string &s, const char *prefix) {
+  size_t i = 0;
+  for (; prefix[i]; ++i) {
+    if (i == s.size() || lowercase(s[i]) != prefix[i]) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief comments kept by the minifier: the doctype and conditional comments.
+ * @param text content of the comment
+ * @returns true if the comment is written
+ */
+static inline bool is_kept_comment(const std::string &text) {
+  return starts_with_lowercase(text, "doctype") || starts_with_lowercase(text, "[if");
+}
+
+/**
+ * @brief check whether a text holds only whitespace.
+ * @param text text to check
+ * @returns true if blank
+ */
+static inline bool is_blank(const std::string &text) {
+  for (auto c: text) {
+    if (!is_html_whitespace(c)) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief elements that may be left open when followed by one of these, per
+ * the optional tags rules of HTML.
+ * @param tag element
+ * @param next tag of the next sibling, nullptr if there is none
+ * @param parent_tag tag of the parent of the element
+ * @returns true if the end tag can be omitted
+ */
+static bool end_tag_optional(const std::string &tag, const std::string *next, const std::string &parent_tag) {
+  static const std::unordered_set<std::string> p_closers = { "address", "article", "aside", "blockquote",
+    "details", "div", "dl", "fieldset", "figcaption", "figure", "footer", "form", "h1", "h2", "h3", "h4",
+    "h5", "h6", "header", "hgroup", "hr", "main", "menu", "nav", "ol", "p", "pre", "section", "table", "ul" };
+  static const std::unordered_set<std::string> p_keepers = { "a", "audio", "del", "ins", "map", "noscript", "video" };
+  if (tag == "li") return !next || *next == "li";
+  if (tag == "p") return next ? p_closers.count(*next) > 0 : !p_keepers.count(parent_tag);
+  if (tag == "td" || tag == "th") return !next || *next == "td" || *next == "th";
+  if (tag == "tr") return !next || *next == "tr";
+  if (tag == "option") return !next || *next == "option" || *next == "optgroup";
+  if (tag == "optgroup") return !next || *next == "optgroup";
+  if (tag == "dd") return !next || *next == "dd" || *next == "dt";
+  if (tag == "dt") return next && (*next == "dd" || *next == "dt");
+  if (tag == "tbody") return !next || *next == "tbody" || *next == "tfoot";
+  if (tag == "thead") return next && (*next == "tbody" || *next == "tfoot");
+  if (tag == "tfoot" || tag == "html" || tag == "body") return !next;
+  if (tag == "head") return true;
+  return false;
+}
+
+/**
+ * @brief write an attribute value, unquoted when an HTML parser reads it back unchanged.
+ * @param buffop output buffer
+ * @param value attribute value, not empty
+ * @returns void
+ */
+static void append_attribute_value(std::string &buffop, const std::string &value) {
+  bool has_double = false, has_single = false, unquoted = true;
+  for (auto c: value) {
+    if (is_html_whitespace(c) || c == '=' || c == '<' || c == '>' || c == '`') unquoted = false;
+    has_double |= c == '"';
+    has_single |= c == '\'';
+  }
+  if (unquoted && !has_double && !has_single) {
+    buffop += value;
+    return;
+  }
+  const char quote = (has_double && !has_single) ? '\'' : '"';
+  buffop.push_back(quote);
+  buffop += value;
+  buffop.push_back(quote);
+}
+
+bool dom_element::minify_drops(const size_t i, const bool preserve) const {
+  const dom_element *x = child_nodes[i];
+  if (x->is_comment) return !is_kept_comment(x->innertext);
+  if (!x->is_text_node || preserve || !is_blank(x->innertext)) return false;
+  // whitespace only matters between inline content: text and inline elements,
+  // the edges of an inline element included.
+  for (const int step: { -1, 1 }) {
+    size_t j = i;
+    while (true) {
+      if ((step < 0 && j == 0) || (step > 0 && j + 1 == child_nodes.size())) {
+        if (!html_parser::inline_elem.count(tag)) return true;
+        break;
+      }
+      j += step;
+      const dom_element *y = child_nodes[j];
+      if (y->is_comment) continue;
+      if (!y->is_text_node && !html_parser::inline_elem.count(y->tag)) return true;
+      break;
+    }
+  }
+  return false;
+}
+
+void dom_element::__construct_minified_innerHTML(std::string &buffop, const bool preserve,
+  const dom_element *following) const {
+  if (parent) {
+    if (is_comment) {
+      // only kept comments get here.
+      if (starts_with_lowercase(innertext, "doctype")) {
+        buffop += "<!";
+        buffop += innertext;
+        buffop.push_back('>');
+      } else {
+        buffop += "<!--";
+        buffop += innertext;
+        buffop += "-->";
+      }
+      return;
+    }
+    if (is_text_node) {
+      if (preserve) {
+        buffop += innertext;
+        return;
+      }
+      // collapse whitespace runs, across text nodes that only a dropped comment separated.
+      bool space = !buffop.empty() && buffop.back() == ' ';
+      for (auto c: innertext) {
+        if (!is_html_whitespace(c)) {
+          buffop.push_back(c);
+          space = false;
+        } else if (!space) {
+          buffop.push_back(' ');
+          space = true;
+        }
+      }
+      return;
+    }
+    buffop.push_back('<');
+    buffop += tag;
+    for (auto &x: attr) {
+      buffop.push_back(' ');
+      buffop += x.first;
+      if (!x.second.empty()) {
+        buffop.push_back('=');
+        append_attribute_value(buffop, x.second);
+      }
+    }
+    buffop.push_back('>');
+    if (is_non_terminating) {
+      return;
+    }
+  }
+  const bool keep = preserve || tag == "pre" || html_parser::p_text_tag.count(tag);
+  size_t next = 0;
+  while (next < child_nodes.size() && minify_drops(next, keep)) ++next;
+  while (next < child_nodes.size()) {
+    const size_t i = next;
+    for (++next; next < child_nodes.size() && minify_drops(next, keep); ++next) { }
+    child_nodes[i]->__construct_minified_innerHTML(buffop, keep, next < child_nodes.size() ? child_nodes[next] : nullptr);
+  }
+  if (!parent) {
+    return;
+  }
+  // an end tag followed by text or a comment is always written.
+  const bool next_is_element = following && !following->is_text_node && !following->is_comment;
+  if (following && !next_is_element) {
+    buffop += "</";
+    buffop += tag;
+    buffop.push_back('>');
+    return;
+  }
+  if (!end_tag_optional(tag, next_is_element ? &following->tag : nullptr, parent->tag)) {
+    buffop += "</";
+    buffop += tag;
+    buffop.push_back('>');
+  }
+}
+
+std::string dom_element::minified_innerHTML() const {
+  std::string output = "";
+  __construct_minified_innerHTML(output, false, nullptr);
+  return output;
+}
+
+void dom_element::element_iterator::advance(const bool descend) {
+  if (descend && !current->children.empty()) {
+    if (depth < tracked_depth) {
+      parent_at[depth] = current;
+      index[depth] = 0;
+    }
+    ++depth;
+    current = current->children[0];
+    return;
+  }
+  // next sibling of the current node or of its closest ancestor having one.
+  while (depth) {
+    const bool tracked = depth <= tracked_depth;
+    const dom_element *parent = tracked ? parent_at[depth - 1] : current->parent;
+    const std::vector<dom_element *> &siblings = parent->children;
+    size_t i = 0;
+    if (tracked) {
+      i = index[depth - 1];
+    } else {
+      while (siblings[i] != current) ++i;
+    }
+    if (i + 1 < siblings.size()) {
+      if (tracked) index[depth - 1] = static_cast<uint32_t>(i + 1);
+      current = siblings[i + 1];
+      return;
+    }
+    current = parent;
+    --depth;
+  }
+  current = nullptr;
+}
+
+dom_element::element_iterator dom_element::element_range::begin() const {
+  element_iterator iter;
+  iter.root = root;
+  iter.filter = filter;
+  iter.name = name;
+  if (!root->children.empty()) {
+    iter.current = root->children[0];
+    iter.depth = 1;
+    iter.parent_at[0] = root;
+    iter.index[0] = 0;
+    iter.settle();
+  }
+  return iter;
+}
+
+/**
+ * @brief add the heap storage of a string.
+ * @param s string to measure
+ * @param category category to add to
+ * @returns void
+ */
+static void add_string(const std::string &s, memory_category &category) {
+  const char *data = s.data();
+  const char *object = reinterpret_cast<const char *>(&s);
+  if (data >= object && data < object + sizeof(std::string)) {
+    // short string stored inside the object.
+    return;
+  }
+  category.used += s.size() + 1;
+  category.slack += s.capacity() - s.size();
+}
+
+/**
+ * @brief add the storage of a vector, not of what its elements point to.
+ * @param v vector to measure
+ * @param category category to add to
+ * @returns void
+ */
+template <typename __value_type>
+static void add_vector(const std::vector<__value_type> &v, memory_category &category) {
+  category.used += v.size() * sizeof(__value_type);
+  category.slack += (v.capacity() - v.size()) * sizeof(__value_type);
+}
+
+void dom_element::memory_report(memory_usage &usage) const {
+  usage.node_structs.used += sizeof(dom_element);
+  add_vector(child_nodes, usage.child_nodes);
+  add_vector(children, usage.children);
+  add_string(tag, usage.tag);
+  add_string(innertext, usage.text);
+  add_vector(class_list, usage.class_list);
+  for (auto &x: class_list) {
+    add_string(x, usage.class_list);
+  }
+  add_string(id, usage.id_class);
+  add_string(_class, usage.id_class);
+  // a node holds the next pointer, the key/value pair and the cached hash.
+  usage.attributes.used += attr.size() * (sizeof(void *) + sizeof(std::pair<const std::string, std::string>) + sizeof(size_t));
+  if (attr.bucket_count() > 1) {
+    // a single bucket lives inside the map object.
+    usage.attributes.used += attr.size() * sizeof(void *);
+    usage.attributes.slack += (attr.bucket_count() - attr.size()) * sizeof(void *);
+  }
+  for (auto &x: attr) {
+    add_string(x.first, usage.attributes);
+    add_string(x.second, usage.attributes);
+  }
+  for (auto &x: child_nodes) {
+    x->memory_report(usage);
+  }
+}
+
 dom_element::~dom_element () {
   if (child_nodes.size()) {
     for (;!child_nodes.empty();) {
@@ -0,0 +1,253 @@
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "include/encoding.hpp"
+
+/// Unicode code points of windows-1252 bytes 0x80 - 0x9f
+static const uint16_t cp1252_high[32] = {
+  0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+  0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+  0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+  0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178
+};
+
+/**
+ * @brief write a code point as UTF-8.
+ * @param cp code point
+ * @param out output cursor, advanced past the written bytes
+ * @returns void
+ */
+static inline void put_utf8(const uint32_t cp, char *&out) {
+  if (cp < 0x80) {
+    *out++ = cp;
+  } else if (cp < 0x800) {
+    *out++ = 0xc0 | (cp >> 6);
+    *out++ = 0x80 | (cp & 0x3f);
+  } else if (cp < 0x10000) {
+    *out++ = 0xe0 | (cp >> 12);
+    *out++ = 0x80 | ((cp >> 6) & 0x3f);
+    *out++ = 0x80 | (cp & 0x3f);
+  } else {
+    *out++ = 0xf0 | (cp >> 18);
+    *out++ = 0x80 | ((cp >> 12) & 0x3f);
+    *out++ = 0x80 | ((cp >> 6) & 0x3f);
+    *out++ = 0x80 | (cp & 0x3f);
+  }
+}
+
+/**
+ * @brief lowercase an ASCII letter.
+ * @param c character
+ * @returns lowercase character
+ */
+static inline char ascii_lower(const char c) { return (c >= 'A' && c <= 'Z') ? (c | 32) : c; }
+
+/**
+ * @brief case-insensitive comparison of a name against a lowercase literal.
+ * @param name name to check, not terminated
+ * @param size length of name
+ * @param literal lowercase literal
+ * @returns true if equal
+ */
+static bool name_is(const char *name, const size_t size, const char *literal) {
+  if (strlen(literal) != size) return false;
+  for (size_t i = 0; i < size; ++i) {
+    if (ascii_lower(name[i]) != literal[i]) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief map a charset label to an encoding.
+ * @param name label
+ * @param size length of label
+ * @param enc set to the encoding
+ * @returns false if the label is not known.
+ */
+static bool encoding_from_label(const char *name, const size_t size, text_encoding &enc) {
+  // a meta tag claiming UTF-16 means UTF-8, the bytes being read are ASCII compatible.
+  if (name_is(name, size, "utf-8") || name_is(name, size, "utf8") || name_is(name, size, "utf-16") ||
+      name_is(name, size, "utf-16le") || name_is(name, size, "utf-16be")) {
+    enc = text_encoding::utf8;
+    return true;
+  }
+  if (name_is(name, size, "windows-1252") || name_is(name, size, "cp1252") || name_is(name, size, "iso-8859-1") ||
+      name_is(name, size, "iso8859-1") || name_is(name, size, "latin1") || name_is(name, size, "l1") ||
+      name_is(name, size, "us-ascii") || name_is(name, size, "ascii")) {
+    enc = text_encoding::windows_1252;
+    return true;
+  }
+  return false;
+}
+
+text_encoding sniff_encoding(const char *data, const size_t size, size_t &bom_length, bool &declared) {
+  const unsigned char *s = reinterpret_cast<const unsigned char *>(data);
+  bom_length = 0;
+  declared = true;
+  if (size >= 3 && s[0] == 0xef && s[1] == 0xbb && s[2] == 0xbf) {
+    bom_length = 3;
+    return text_encoding::utf8;
+  }
+  if (size >= 2 && s[0] == 0xff && s[1] == 0xfe) {
+    bom_length = 2;
+    return text_encoding::utf16le;
+  }
+  if (size >= 2 && s[0] == 0xfe && s[1] == 0xff) {
+    bom_length = 2;
+    return text_encoding::utf16be;
+  }
+  // prescan: look for charset= inside a <meta ...> tag.
+  const size_t end = size < ENCODING_PRESCAN_SIZE ? size : ENCODING_PRESCAN_SIZE;
+  for (size_t i = 0; i + 5 < end; ++i) {
+    if (data[i] != '<' || !name_is(data + i + 1, 4, "meta")) continue;
+    size_t j = i + 5;
+    while (j + 8 < end && data[j] != '>') {
+      if (!name_is(data + j, 7, "charset")) {
+        ++j;
+        continue;
+      }
+      j += 7;
+      while (j < end && (data[j] == ' ' || data[j] == '\t' || data[j] == '\n')) ++j;
+      if (j >= end || data[j] != '=') continue;
+      ++j;
+      while (j < end && (data[j] == ' ' || data[j] == '\t' || data[j] == '\n' || data[j] == '"' || data[j] == '\'')) ++j;
+      const size_t label = j;
+      while (j < end && data[j] != '"' && data[j] != '\'' && data[j] != ';' && data[j] != '>' &&
+             data[j] != ' ' && data[j] != '/') ++j;
+      text_encoding enc;
+      if (encoding_from_label(data + label, j - label, enc)) return enc;
+      break;
+    }
+  }
+  declared = false;
+  return text_encoding::utf8;
+}
+
+size_t validate_utf8(const char *data, const size_t size) {
+  const unsigned char *s = reinterpret_cast<const unsigned char *>(data);
+  size_t i = 0;
+  while (i < size) {
+#ifdef __SSE2__
+    // skip ASCII 16 bytes at a time.
+    while (i + 16 <= size && !_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)))) {
+      i += 16;
+    }
+    if (i >= size) break;
+#endif
+    const unsigned char c = s[i];
+    if (c < 0x80) {
+      ++i;
+      continue;
+    }
+    size_t len;
+    if (c >= 0xc2 && c <= 0xdf) len = 2;
+    else if ((c & 0xf0) == 0xe0) len = 3;
+    else if (c >= 0xf0 && c <= 0xf4) len = 4;
+    else return i;
+    if (i + len > size) return i;
+    for (size_t k = 1; k < len; ++k) {
+      if ((s[i + k] & 0xc0) != 0x80) return i;
+    }
+    // reject overlong forms, surrogates and code points past U+10FFFF.
+    if ((c == 0xe0 && s[i + 1] < 0xa0) || (c == 0xed && s[i + 1] > 0x9f) ||
+        (c == 0xf0 && s[i + 1] < 0x90) || (c == 0xf4 && s[i + 1] > 0x8f)) {
+      return i;
+    }
+    i += len;
+  }
+  return size;
+}
+
+utf8_transcoder::utf8_transcoder(const text_encoding from):
+  from(from), pending_byte(0), has_pending_byte(false), high_surrogate(0) { }
+
+size_t utf8_transcoder::convert(const char *data, const size_t size, char *out) {
+  const unsigned char *s = reinterpret_cast<const unsigned char *>(data);
+  char *const begin = out;
+  size_t i = 0;
+  switch (from) {
+    case text_encoding::utf8:
+      // copy valid runs, replace each invalid byte.
+      while (i < size) {
+        const size_t valid = validate_utf8(data + i, size - i);
+        memcpy(out, data + i, valid);
+        out += valid;
+        i += valid;
+        if (i < size) {
+          put_utf8(0xfffd, out);
+          ++i;
+        }
+      }
+      break;
+    case text_encoding::windows_1252:
+      while (i < size) {
+#ifdef __SSE2__
+        while (i + 16 <= size) {
+          const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+          if (_mm_movemask_epi8(v)) break;
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v);
+          out += 16;
+          i += 16;
+        }
+        if (i >= size) break;
+#endif
+        const unsigned char c = s[i++];
+        if (c < 0x80) {
+          *out++ = c;
+        } else if (c < 0xa0) {
+          put_utf8(cp1252_high[c - 0x80], out);
+        } else {
+          put_utf8(c, out);
+        }
+      }
+      break;
+    case text_encoding::utf16le:
+    case text_encoding::utf16be: {
+      const bool le = from == text_encoding::utf16le;
+      while (i < size) {
+#ifdef __SSE2__
+        // 8 ASCII code units at a time, when no unit is split or pending.
+        if (!has_pending_byte && !high_surrogate) {
+          const __m128i high_mask = _mm_set1_epi16(static_cast<short>(0xff80));
+          while (i + 16 <= size) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+            if (!le) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, high_mask), _mm_setzero_si128())) != 0xffff) break;
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(v, v));
+            out += 8;
+            i += 16;
+          }
+          if (i >= size) break;
+        }
+#endif
+        if (!has_pending_byte) {
+          pending_byte = s[i++];
+          has_pending_byte = true;
+          continue;
+        }
+        has_pending_byte = false;
+        const uint16_t unit = le ? (pending_byte | (s[i] << 8)) : ((pending_byte << 8) | s[i]);
+        ++i;
+        if (high_surrogate) {
+          if (unit >= 0xdc00 && unit <= 0xdfff) {
+            put_utf8(0x10000 + ((high_surrogate - 0xd800) << 10) + (unit - 0xdc00), out);
+            high_surrogate = 0;
+            continue;
+          }
+          put_utf8(0xfffd, out);
+          high_surrogate = 0;
+        }
+        if (unit >= 0xd800 && unit <= 0xdbff) {
+          high_surrogate = unit;
+        } else if (unit >= 0xdc00 && unit <= 0xdfff) {
+          put_utf8(0xfffd, out);
+        } else {
+          put_utf8(unit, out);
+        }
+      }
+      break;
+    }
+  }
+  return out - begin;
+}
@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "include/frozen_document.hpp"
+#include "include/thread_pool.hpp"
+
+const frozen_document::node_id frozen_document::npos;
+
+/**
+ * @brief round an offset up to the alignment of the arrays.
+ * @param offset offset in the block
+ * @returns aligned offset
+ */
+static inline size_t align_up(const size_t offset) {
+  return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+/**
+ * @brief compare a stored string with a std::string.
+ * @param ref stored string
+ * @param s string to compare with
+ * @returns <0, 0 or >0 like strcmp
+ */
+static inline int compare_ref(const frozen_document::text_ref &ref, const std::string &s) {
+  const size_t n = std::min(ref.size, s.size());
+  const int c = memcmp(ref.data, s.data(), n);
+  if (c) return c;
+  return ref.size < s.size() ? -1 : (ref.size > s.size() ? 1 : 0);
+}
+
+frozen_document::text_ref frozen_document::store(const std::string &s, char *&pool) {
+  text_ref ref = { pool, s.size() };
+  memcpy(pool, s.data(), s.size());
+  pool += s.size();
+  return ref;
+}
+
+frozen_document::text_ref frozen_document::keep(const std::string &s, char *&pool) {
+  const string_pool::entry *e = strings ? strings->acquire(s) : nullptr;
+  if (!e) {
+    return store(s, pool);
+  }
+  pooled[pooled_count++] = e;
+  return text_ref{ e->view().data(), s.size() };
+}
+
+frozen_document::frozen_document(const dom_element *root, string_pool *strings): block(nullptr), block_size(0),
+  strings(strings), pooled_count(0) {
+  // first pass: count everything and collect the names.
+  size_t node_count = 0, attr_count = 0, class_count = 0, id_count = 0, chars = 0, pooled_total = 0;
+  // bytes a string takes in the character pool: none if the string pool takes it.
+  auto charge = [strings, &pooled_total](const size_t length) -> size_t {
+    if (!strings || !strings->accepts(length)) return length;
+    ++pooled_total;
+    return 0;
+  };
+  std::vector<std::string> names;
+  std::vector<const dom_element *> stack(1, root);
+  while (!stack.empty()) {
+    const dom_element *x = stack.back();
+    stack.pop_back();
+    ++node_count;
+    if (x->is_text_node || x->is_comment) {
+      chars += charge(x->innertext.size());
+    }
+    if (!x->is_text_node && x->parent) {
+      names.push_back(x->tag);
+    }
+    attr_count += x->attr.size();
+    for (auto &a: x->attr) {
+      names.push_back(a.first);
+      chars += charge(a.second.size());
+    }
+    class_count += x->class_list.size();
+    for (auto &c: x->class_list) {
+      names.push_back(c);
+    }
+    id_count += x->id.size() && x->attr.count("id");
+    for (auto iter = x->child_nodes.rbegin(); iter != x->child_nodes.rend(); ++iter) {
+      // whitespace dropped by the parser comes back as one-space text nodes,
+      // for children only, as in the second pass: the root's flags are not written.
+      const size_t spaces = (*iter)->space_before + (*iter)->space_after;
+      node_count += spaces;
+      chars += spaces;
+      stack.push_back(*iter);
+    }
+  }
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+  for (auto &x: names) {
+    chars += charge(x.size());
+  }
+  nodes = node_count;
+  atoms = names.size();
+  ids = id_count;
+
+  // carve the arrays out of one block, largest alignment first.
+  size_t offsets[18], offset = 0, i = 0;
+  const size_t sizes[18] = {
+    node_count * sizeof(text_ref), attr_count * sizeof(text_ref), atoms * sizeof(text_ref), ids * sizeof(text_ref),
+    node_count * sizeof(node_id), node_count * sizeof(node_id), node_count * sizeof(node_id),
+    node_count * sizeof(node_id), node_count * sizeof(node_id), (node_count + 1) * sizeof(uint32_t),
+    attr_count * sizeof(uint32_t), (node_count + 1) * sizeof(uint32_t), class_count * sizeof(uint32_t),
+    ids * sizeof(node_id), node_count, node_count, chars, pooled_total * sizeof(const string_pool::entry *)
+  };
+  for (i = 0; i < 18; ++i) {
+    offsets[i] = offset = align_up(offset);
+    offset += sizes[i];
+  }
+  block_size = offset;
+  block = new char[block_size ? block_size : 1];
+  node_text = reinterpret_cast<text_ref *>(block + offsets[0]);
+  attr_value = reinterpret_cast<text_ref *>(block + offsets[1]);
+  atom_name = reinterpret_cast<text_ref *>(block + offsets[2]);
+  id_value = reinterpret_cast<text_ref *>(block + offsets[3]);
+  tag_atom = reinterpret_cast<node_id *>(block + offsets[4]);
+  parent = reinterpret_cast<node_id *>(block + offsets[5]);
+  first_child = reinterpret_cast<node_id *>(block + offsets[6]);
+  next_sibling = reinterpret_cast<node_id *>(block + offsets[7]);
+  subtree_end = reinterpret_cast<node_id *>(block + offsets[8]);
+  attr_begin = reinterpret_cast<uint32_t *>(block + offsets[9]);
+  attr_name = reinterpret_cast<uint32_t *>(block + offsets[10]);
+  class_begin = reinterpret_cast<uint32_t *>(block + offsets[11]);
+  class_atom = reinterpret_cast<uint32_t *>(block + offsets[12]);
+  id_node = reinterpret_cast<node_id *>(block + offsets[13]);
+  kind = reinterpret_cast<uint8_t *>(block + offsets[14]);
+  flags = reinterpret_cast<uint8_t *>(block + offsets[15]);
+  char *pool = block + offsets[16];
+  pooled = reinterpret_cast<const string_pool::entry **>(block + offsets[17]);
+
+  for (i = 0; i < atoms; ++i) {
+    atom_name[i] = keep(names[i], pool);
+  }
+  auto atom_of = [&names](const std::string &name) {
+    return static_cast<uint32_t>(std::lower_bound(names.begin(), names.end(), name) - names.begin());
+  };
+
+  // second pass: fill the arrays in document order, nullptr standing for a dropped whitespace run.
+  static const std::string space(" ");
+  std::vector<std::pair<const dom_element *, node_id>> order(1, std::make_pair(root, npos));
+  std::vector<node_id> last_child(node_count, npos);
+  node_id id = 0;
+  uint32_t attr_index = 0, class_index = 0, id_index = 0;
+  while (!order.empty()) {
+    const dom_element *x = order.back().first;
+    const node_id p = order.back().second;
+    order.pop_back();
+    parent[id] = p;
+    first_child[id] = next_sibling[id] = npos;
+    subtree_end[id] = 1;
+    if (p != npos) {
+      if (last_child[p] == npos) {
+        first_child[p] = id;
+      } else {
+        next_sibling[last_child[p]] = id;
+      }
+      last_child[p] = id;
+    }
+    if (!x) {
+      kind[id] = kind_text;
+      flags[id] = 0;
+      tag_atom[id] = npos;
+      node_text[id] = store(space, pool);
+      attr_begin[id] = attr_index;
+      class_begin[id] = class_index;
+      ++id;
+      continue;
+    }
+    kind[id] = !x->parent ? kind_document : x->is_text_node ? kind_text : x->is_comment ? kind_comment : kind_element;
+    flags[id] = x->is_non_terminating ? flag_non_terminating : 0;
+    tag_atom[id] = (kind[id] == kind_element || kind[id] == kind_comment) ? atom_of(x->tag) : npos;
+    node_text[id] = (x->is_text_node || x->is_comment) ? keep(x->innertext, pool) : text_ref{ pool, 0 };
+    attr_begin[id] = attr_index;
+    for (auto &a: x->attr) {
+      attr_name[attr_index] = atom_of(a.first);
+      attr_value[attr_index] = keep(a.second, pool);
+      if (x->id.size() && a.first == "id") {
+        id_value[id_index] = attr_value[attr_index];
+        id_node[id_index++] = id;
+      }
+      ++attr_index;
+    }
+    class_begin[id] = class_index;
+    for (auto &c: x->class_list) {
+      class_atom[class_index++] = atom_of(c);
+    }
+    for (auto iter = x->child_nodes.rbegin(); iter != x->child_nodes.rend(); ++iter) {
+      if ((*iter)->space_after) order.push_back(std::make_pair(nullptr, id));
+      order.push_back(std::make_pair(*iter, id));
+      if ((*iter)->space_before) order.push_back(std::make_pair(nullptr, id));
+    }
+    ++id;
+  }
+  // every slot counted by the first pass is filled.
+  assert(id == nodes);
+  attr_begin[nodes] = attr_index;
+  class_begin[nodes] = class_index;
+  // subtree sizes, children come after their parent.
+  for (node_id n = nodes; n-- > 1;) {
+    subtree_end[parent[n]] += subtree_end[n];
+  }
+  for (node_id n = 0; n < nodes; ++n) {
+    subtree_end[n] += n;
+  }
+  // sort the id index by value, then document order.
+  std::vector<uint32_t> perm(ids);
+  for (i = 0; i < ids; ++i) perm[i] = i;
+  std::sort(perm.begin(), perm.end(), [this](const uint32_t a, const uint32_t b) {
+    const size_t n = std::min(id_value[a].size, id_value[b].size);
+    const int c = memcmp(id_value[a].data, id_value[b].data, n);
+    if (c) return c < 0;
+    if (id_value[a].size != id_value[b].size) return id_value[a].size < id_value[b].size;
+    return id_node[a] < id_node[b];
+  });
+  std::vector<text_ref> sorted_values(ids);
+  std::vector<node_id> sorted_nodes(ids);
+  for (i = 0; i < ids; ++i) {
+    sorted_values[i] = id_value[perm[i]];
+    sorted_nodes[i] = id_node[perm[i]];
+  }
+  std::copy(sorted_values.begin(), sorted_values.end(), id_value);
+  std::copy(sorted_nodes.begin(), sorted_nodes.end(), id_node);
+}
+
+void frozen_document::clear() {
+  for (uint32_t i = 0; i < pooled_count; ++i) {
+    strings->release(pooled[i]);
+  }
+  delete[] block;
+  block = nullptr;
+  block_size = 0;
+  nodes = atoms = ids = pooled_count = 0;
+  node_text = attr_value = atom_name = id_value = nullptr;
+  tag_atom = parent = first_child = next_sibling = subtree_end = id_node = nullptr;
+  attr_begin = attr_name = class_begin = class_atom = nullptr;
+  kind = flags = nullptr;
+  strings = nullptr;
+  pooled = nullptr;
+}
+
+frozen_document::frozen_document(frozen_document &&other): block(nullptr), pooled_count(0) {
+  clear();
+  *this = std::move(other);
+}
+
+frozen_document &frozen_document::operator=(frozen_document &&other) {
+  if (this == &other) {
+    return *this;
+  }
+  clear();
+  block = other.block;
+  block_size = other.block_size;
+  nodes = other.nodes;
+  atoms = other.atoms;
+  ids = other.ids;
+  node_text = other.node_text;
+  attr_value = other.attr_value;
+  atom_name = other.atom_name;
+  id_value = other.id_value;
+  tag_atom = other.tag_atom;
+  parent = other.parent;
+  first_child = other.first_child;
+  next_sibling = other.next_sibling;
+  subtree_end = other.subtree_end;
+  attr_begin = other.attr_begin;
+  attr_name = other.attr_name;
+  class_begin = other.class_begin;
+  class_atom = other.class_atom;
+  id_node = other.id_node;
+  kind = other.kind;
+  flags = other.flags;
+  strings = other.strings;
+  pooled = other.pooled;
+  pooled_count = other.pooled_count;
+  // other owns nothing anymore: its destructor must not free or release.
+  other.block = nullptr;
+  other.pooled_count = 0;
+  other.clear();
+  return *this;
+}
+
+frozen_document::~frozen_document() {
+  clear();
+}
+
+uint32_t frozen_document::find_atom(const std::string &name) const {
+  uint32_t lo = 0, hi = atoms;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    const int c = compare_ref(atom_name[mid], name);
+    if (c == 0) return mid;
+    if (c < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return npos;
+}
+
+bool frozen_document::has_classname(const node_id node, const std::string &classname) const {
+  const uint32_t atom = find_atom(classname);
+  return atom != npos && has_class_atom(node, atom);
+}
+
+std::string frozen_document::get_attribute_value(const node_id node, const std::string &attribute_name) const {
+  const uint32_t atom = find_atom(attribute_name);
+  if (atom != npos) {
+    for (uint32_t i = attr_begin[node]; i < attr_begin[node + 1]; ++i) {
+      if (attr_name[i] == atom) return std::string(attr_value[i].data, attr_value[i].size);
+    }
+  }
+  return "";
+}
+
+frozen_document::node_id frozen_document::get_element_by_id(const std::string &id) const {
+  uint32_t lo = 0, hi = ids;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (compare_ref(id_value[mid], id) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  // like dom_element::get_element_by_id, the root itself is not a match.
+  if (lo < ids && id_node[lo] == 0) ++lo;
+  if (lo < ids && compare_ref(id_value[lo], id) == 0) {
+    return id_node[lo];
+  }
+  return npos;
+}
+
+std::vector<frozen_document::node_id> frozen_document::get_elements_by_tag_name(const std::string &tagname, const node_id node) const {
+  std::vector<node_id> dom;
+  const uint32_t atom = find_atom(tagname);
+  if (atom == npos) return dom;
+  for (node_id i = node + 1, end = subtree_end[node]; i < end; ++i) {
+    if (tag_atom[i] == atom) dom.push_back(i);
+  }
+  return dom;
+}
+
+void frozen_document::class_range(const uint32_t atom, const node_id node, node_id begin, const node_id end,
+  std::vector<node_id> &dom) const {
+  // a range starting inside a match begins after the outermost matching ancestor.
+  for (node_id x = parent[begin]; x != node && x != npos; x = parent[x]) {
+    if (has_class_atom(x, atom)) begin = subtree_end[x];
+  }
+  node_id i = begin;
+  while (i < end) {
+    if (has_class_atom(i, atom)) {
+      dom.push_back(i);
+      i = subtree_end[i];
+    } else {
+      ++i;
+    }
+  }
+}
+
+std::vector<frozen_document::node_id> frozen_document::get_elements_by_class_name(const std::string &classname, const node_id node) const {
+  std::vector<node_id> dom;
+  const uint32_t atom = find_atom(classname);
+  if (atom == npos) return dom;
+  class_range(atom, node, node + 1, subtree_end[node], dom);
+  return dom;
+}
+
+/**
+ * @brief run a scan over the range (node, end) cut into document-order pieces.
+ * @param policy sequential or parallel evaluation
+ * @param node node the query searches below
+ * @param end end of the range
+ * @param scan function scanning [begin, end) into a list
+ * @returns concatenated results of the pieces
+ */
+template <typename scan_type>
+static std::vector<frozen_document::node_id> split_range(const execution_policy &policy, const frozen_document::node_id node,
+  const frozen_document::node_id end, const scan_type &scan) {
+  std::vector<frozen_document::node_id> dom;
+  const size_t length = end - node - 1;
+  const size_t pieces = std::min(policy.task_count(), std::max<size_t>(1, length / 4096));
+  if (pieces <= 1) {
+    scan(node + 1, end, dom);
+    return dom;
+  }
+  std::vector<std::vector<frozen_document::node_id>> results(pieces);
+  policy.pool->parallel_for(pieces, [&](const size_t i) {
+    scan(node + 1 + length * i / pieces, node + 1 + length * (i + 1) / pieces, results[i]);
+  });
+  size_t total = 0;
+  for (auto &x: results) total += x.size();
+  dom.reserve(total);
+  for (auto &x: results) dom.insert(dom.end(), x.begin(), x.end());
+  return dom;
+}
+
+std::vector<frozen_document::node_id> frozen_document::get_elements_by_tag_name(const std::string &tagname,
+  const execution_policy &policy, const node_id node) const {
+  const uint32_t atom = find_atom(tagname);
+  if (atom == npos) return std::vector<node_id>();
+  return split_range(policy, node, subtree_end[node], [this, atom](node_id begin, const node_id end, std::vector<node_id> &dom) {
+    for (; begin < end; ++begin) {
+      if (tag_atom[begin] == atom) dom.push_back(begin);
+    }
+  });
+}
+
+std::vector<frozen_document::node_id> frozen_document::get_elements_by_class_name(const std::string &classname,
+  const execution_policy &policy, const node_id node) const {
+  const uint32_t atom = find_atom(classname);
+  if (atom == npos) return std::vector<node_id>();
+  return split_range(policy, node, subtree_end[node], [this, atom, node](const node_id begin, const node_id end, std::vector<node_id> &dom) {
+    class_range(atom, node, begin, end, dom);
+  });
+}
+
+std::string frozen_document::innerText(const node_id node) const {
+  if (kind[node] == kind_text) {
+    return std::string(node_text[node].data, node_text[node].size);
+  }
+  std::string value = "";
+  for (node_id i = node + 1, end = subtree_end[node]; i < end; ++i) {
+    if (kind[i] == kind_text) value.append(node_text[i].data, node_text[i].size);
+  }
+  return value;
+}
+
+void frozen_document::construct_innerHTML(const node_id node, std::string &buffop) const {
+  const text_ref &text = node_text[node];
+  switch (kind[node]) {
+    case kind_document:
+      for (node_id c = first_child[node]; c != npos; c = next_sibling[c]) {
+        construct_innerHTML(c, buffop);
+      }
+      return;
+    case kind_comment:
+      if (compare_ref(text, "DOCTYPE html") && compare_ref(text, "doctype html")) {
+        buffop += "<!--";
+        buffop.append(text.data, text.size);
+        buffop += "-->";
+      } else {
+        buffop += "<!";
+        buffop.append(text.data, text.size);
+        buffop += ">";
+      }
+      return;
+    case kind_text:
+      buffop.append(text.data, text.size);
+      return;
+    default:
+      break;
+  }
+  const text_ref &tag = atom_name[tag_atom[node]];
+  buffop.push_back('<');
+  buffop.append(tag.data, tag.size);
+  for (uint32_t i = attr_begin[node]; i < attr_begin[node + 1]; ++i) {
+    buffop.push_back(' ');
+    buffop.append(atom_name[attr_name[i]].data, atom_name[attr_name[i]].size);
+    buffop += "=\"";
+    buffop.append(attr_value[i].data, attr_value[i].size);
+    buffop.push_back('"');
+  }
+  if (flags[node] & flag_non_terminating) {
+    buffop += " />";
+    return;
+  }
+  buffop.push_back('>');
+  for (node_id c = first_child[node]; c != npos; c = next_sibling[c]) {
+    construct_innerHTML(c, buffop);
+  }
+  buffop += "</";
+  buffop.append(tag.data, tag.size);
+  buffop.push_back('>');
+}
+
+std::string frozen_document::innerHTML(const node_id node) const {
+  std::string output = "";
+  construct_innerHTML(node, output);
+  return output;
+}
+
+frozen_document dom_element::freeze() const {
+  return frozen_document(this);
+}
+
+frozen_document dom_element::freeze(string_pool &strings) const {
+  return frozen_document(this, &strings);
+}
@@ -1,4 +1,11 @@
+#include <thread>
 #include "include/html_parser.hpp"
+#include "include/html_tokenizer.hpp"
+#include "include/html_tree_builder.hpp"
+#include "include/spsc_queue.hpp"
+
+/// number of token slots between the tokenizer and tree builder threads
+#define TOKEN_QUEUE_SIZE 1024
 
 #define DBG(_x) std::cout << _x
 #define DBGLN(_x) DBG(_x) << std::endl
@@ -7,11 +14,10 @@
 #define DBGV(_x) std::cout << #_x << " is " << _x
 #define DBGVLN(_x) DBGV(_x) << std::endl
 #define DBGVSP(_x) DBGV(_x) << ' '
-#define EXIT_IF_FILE_ENDED(read, err_message) \
+#define RETURN_IF_FILE_ENDED(read, err_message) \
   if (read == EOF) { \
-    std::cerr << err_message << "\n"; \
-    std::cerr << "\tat line " << line_number << ":" << character_in_a_line << '\n'; \
-    exit(-1); \
+    input_ended(err_message); \
+    return; \
   }
 
 #define ERR_MSG(condition, err_message) \
@@ -20,24 +26,36 @@
     std::cerr << "\tat line " << line_number << ":" << character_in_a_line << '\n'; \
   }
 
-dom_element* html_parser::read_file() {
-  dom_element *dom = new dom_element(nullptr);
+template <typename parse_policy>
+dom_element* basic_html_parser<parse_policy>::read_file() {
+  // nodes are numbered in pre-order as they are created.
+  next_order = 0;
+  numbering_root = nullptr;
+  // max_nodes is at least 1: the document node is always built.
+  dom_element *dom = create_node(nullptr);
+  dom->order_root = numbering_root = dom;
   while (read != EOF) {
     read = read_char();
     switch(read) {
       case '<':
-        dom_element *child = read_tags(dom);
+        dom_element *child = read_tags(dom, '\0', comment_is_kept(false));
         if (child && child->tag.size()) {
           dom->child_nodes.push_back(child);
           dom->children.push_back(dom->child_nodes.back());
+        } else if (child) {
+          // the input ended (or a limit was hit) before the tag name.
+          recycle_node(child);
         }
         break;
     }
   }
+  dom->order_end = next_order;
+  if (hashes) hashes->hash(dom);
   return dom;
 }
 
-void html_parser::read_tag_name(dom_element *dom, const char was_prev_read) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::read_tag_name(dom_element *dom, const char was_prev_read) {
   if (read == '!') {
     // DBGLN("Comment incoming");
     dom->tag = "#comment";
@@ -57,11 +75,11 @@ void html_parser::read_tag_name(dom_element *dom, const char was_prev_read) {
           while (!is_comment_terminated) {
             read = read_char();
             // read till dash
-            while (read != EOF && read != '-') {
-              dom->innertext.push_back(read);
+            while (read != EOF && read != '-' && text_fits(dom->innertext)) {
+              if constexpr (parse_policy::build_comments) dom->innertext.push_back(read);
               read = read_char();
             }
-            EXIT_IF_FILE_ENDED(read, "File ended without closing comment '-->'");
+            RETURN_IF_FILE_ENDED(read, "File ended without closing comment '-->'");
             // dash exist
             read = read_char();
             // if dash again, scan for next character
@@ -84,11 +102,11 @@ void html_parser::read_tag_name(dom_element *dom, const char was_prev_read) {
         } else {
           // second char is not dash, greedy approach, keep scanning till 
           // '>' is scanned
-          while (read != EOF && read != '>') {
-            dom->innertext.push_back(read);
+          while (read != EOF && read != '>' && text_fits(dom->innertext)) {
+            if constexpr (parse_policy::build_comments) dom->innertext.push_back(read);
             read = read_char();
           }
-          EXIT_IF_FILE_ENDED(read, "File ended without closing comment '->'");
+          RETURN_IF_FILE_ENDED(read, "File ended without closing comment '->'");
           // closing tag found, skip it
           read = read_char();
           is_comment_terminated = true;
@@ -96,11 +114,11 @@ void html_parser::read_tag_name(dom_element *dom, const char was_prev_read) {
       } else {
         // first char is not dash, greedy approach, keep scanning till 
         // '>' is scanned
-        while (read != EOF && read != '>') {
-          dom->innertext.push_back(read);
+        while (read != EOF && read != '>' && text_fits(dom->innertext)) {
+          if constexpr (parse_policy::build_comments) dom->innertext.push_back(read);
           read = read_char();
         }
-        EXIT_IF_FILE_ENDED(read, "File ended without closing comment '>'");
+        RETURN_IF_FILE_ENDED(read, "File ended without closing comment '>'");
         // closing tag found, skip it
         read = read_char();
         is_comment_terminated = true;
@@ -115,49 +133,65 @@ void html_parser::read_tag_name(dom_element *dom, const char was_prev_read) {
       dom->tag.push_back(char_to_lowercase(read));
       read = read_char();
     }
-    if (!head_dom_hit) {
-      dom->is_head = head_dom_hit = !head_dom_hit && dom->tag == "head";
+    if constexpr (parse_policy::detect_head_body) {
+      if (!head_dom_hit) {
+        dom->is_head = head_dom_hit = !head_dom_hit && dom->tag == "head";
+        if (dom->is_head) head_element = dom;
+      }
+      if (!body_dom_hit) {
+        dom->is_body = body_dom_hit = !body_dom_hit && dom->tag == "body";
+        if (dom->is_body) body_element = dom;
+      }
     }
-    if (!body_dom_hit) {
-      dom->is_body = body_dom_hit = !body_dom_hit && dom->tag == "body";
+    // which head or body comes first depends on the rest of the document.
+    if (reparsing && (dom->tag == "head" || dom->tag == "body")) {
+      reparse_escaped = true;
     }
   }
 }
 
-void html_parser::read_attributes(dom_element *dom) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::read_attributes(dom_element *dom, const bool store) {
+  uint32_t skipped = 0;
   while (read != EOF && read != '>' && read != '/') {
+    if ((store ? dom->attr.size() : skipped) >= attribute_budget) {
+      halt(parse_status::attribute_limit);
+      return;
+    }
     // read attr_key
-    std::string key = "", value = "";
+    std::string &key = key_scratch;
+    key.clear();
     // starts with negate sign, then boolean value
     if (read == '!') {
-      value = "false";
       read = read_char();
       while (is_alpha_num(read) || read == '-' || read == '_' || read == ':') {
         key.push_back(char_to_lowercase(read));
         read = read_char();
-        dom->attr.emplace(key, "false");
+        if (store) dom->attr.emplace(key, "false");
       }
-      EXIT_IF_FILE_ENDED(read, "File end without complete tag read: " + key);
+      RETURN_IF_FILE_ENDED(read, "File end without complete tag read: " + key);
     } else {
       // value might be a string, check
       while (read != EOF && is_alpha_num(read) || read == '-' || read == '_' || read == ':') {
         key.push_back(char_to_lowercase(read));
         read = read_char();
       }
-      EXIT_IF_FILE_ENDED(read, "File end without reading attribute key: " + key);
+      RETURN_IF_FILE_ENDED(read, "File end without reading attribute key: " + key);
       // skip whitespaces
       skip_whitespaces();
       // if another attribute is mentioned, then value is true
       if (is_alpha_num(read) || read == '-' || read == '_' || read == ':' || read == '!') {
         // DBGLN("No value, set it as true");
-        dom->attr.emplace(key, "true");
+        if (store) dom->attr.emplace(key, "true");
       }
       // else check if it has value
       else if (read == '='){
         // value is readable, either with or without inverted commas
         read = read_char();
         skip_whitespaces();
-        auto iter = dom->attr.emplace(key, "").first;
+        // a value not stored goes to scratch space, reused from tag to tag.
+        std::string &value = store ? dom->attr.emplace(key, "").first->second : value_scratch;
+        value.clear();
         // DBGLN("Find value for key: " + key);
         // if inverted commas, read the value, else read till whitespace.
         if (read == '\'' || read == '"') {
@@ -167,31 +201,31 @@ void html_parser::read_attributes(dom_element *dom) {
           bool valid_attribute = false;
           while (!valid_attribute) {
             read = read_char();
-            while (read != EOF && read != inv && read != '"') {
-              iter->second.push_back(read);
+            while (read != EOF && read != inv && read != '"' && text_fits(value)) {
+              value.push_back(read);
               read = read_char();
             }
-            EXIT_IF_FILE_ENDED(read, "File end without attribute inverted comma close")
+            RETURN_IF_FILE_ENDED(read, "File end without attribute inverted comma close")
             // if inverted comma ends with ", we will verify whether it
             // has delimiter or not.
             if (inv == '"') {
-              if (iter->second.back() != '\\') {
+              if (value.empty() || value.back() != '\\') {
                 // the inverted comma is not escaped, that means it ends here.
                 valid_attribute = true;
               } else {
                 // the character is escaped
-                iter->second.push_back(inv);
+                value.push_back(inv);
               }
             } else {
               if (read == '"') {
                 // This is single inverted comma.
                 // We are using double inverted comma for simplicity.
                 // Push delimiter for keeping the string valid.
-                iter->second.push_back('\\');
+                value.push_back('\\');
               } else {
-                if (iter->second.back() == '\\') {
+                if (!value.empty() && value.back() == '\\') {
                   // Delimiter exists
-                  iter->second.pop_back();
+                  value.pop_back();
                 } else {
                   valid_attribute = true;
                 }
@@ -200,31 +234,44 @@ void html_parser::read_attributes(dom_element *dom) {
           }
           // skip the inverted comma
           read = read_char();
-          // DBGLN(iter->first + "=" + iter->second);
+          // DBGLN(key + "=" + value);
         } else {
           // std::cout << "Next char: " << read << ' ';
-          while (!is_a_whitespace(read) && read != '>') {
-            iter->second.push_back(read);
+          while (read != EOF && !is_a_whitespace(read) && read != '>' && text_fits(value)) {
+            value.push_back(read);
             read = read_char();
           }
         }
       }
     }
+    if (key.empty() && read != EOF && read != '>' && read != '/' && read != '=') {
+      // a character that cannot start a name (a stray ',' or quote): skip it
+      // instead of looping on it.
+      read = read_char();
+      continue;
+    }
     // escape values - no need if value after equal is taken as exactly as mentioned.
     // attr[key] = value;
-    if (key.size() == 5 && key == "class") {
+    if (!store) {
+      ++skipped;
+    } else if (key.size() == 5 && key == "class") {
+      const std::string &value = dom->attr[key];
       dom->_class = value;
       construct_class_list(dom, value);
     } else if(key.size() == 2 && key == "id") {
-      dom->id = value;
+      dom->id = dom->attr[key];
     }
     skip_whitespaces();
   }
 }
 
-void html_parser::construct_class_list(dom_element *dom, const std::string &value) {
-  uint32_t i = 0;
-  const uint32_t sz = value.size();
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::construct_class_list(dom_element *dom, const std::string &value) {
+  if constexpr (!parse_policy::build_class_list) {
+    return;
+  }
+  size_t i = 0;
+  const size_t sz = value.size();
   while (i < sz) {
     // skip whitespace.
     while (i < sz && is_a_whitespace(value[i])) { ++i; }
@@ -235,10 +282,15 @@ void html_parser::construct_class_list(dom_element *dom, const std::string &valu
   }
 }
 
-dom_element* html_parser::read_tags(dom_element *parent_dom, const char was_prev_read) {
+template <typename parse_policy>
+dom_element* basic_html_parser<parse_policy>::read_tags(dom_element *parent_dom, const char was_prev_read,
+  const bool keep_comment) {
   // skip whitespaces
   bool valid = false;
-  dom_element* dom = new dom_element(parent_dom);
+  dom_element* dom = create_node(parent_dom);
+  if (!dom) {
+    return nullptr;
+  }
   while (read != EOF && !valid) {
     if (read != EOF && read == '<') {
       read = read_char();
@@ -252,6 +304,8 @@ dom_element* html_parser::read_tags(dom_element *parent_dom, const char was_prev
       read = read_char();
     } else {
       valid = true;
+      // the '<' is right before the current character.
+      dom->source_begin = total_character - 2;
       // skip whitespaces: this case is not possible, but still
       skip_whitespaces();
       // first tags
@@ -260,15 +314,27 @@ dom_element* html_parser::read_tags(dom_element *parent_dom, const char was_prev
       //   DBGLN("comment found");
       // }
       if (dom->is_comment) {
+        if (!keep_comment) {
+          recycle_node(dom);
+          return nullptr;
+        }
+        dom->source_length = total_character - 1 - dom->source_begin;
         return dom;
       }
     }
   }
+  // a filter on tag names alone decides here: the attributes of an element
+  // it rejects are scanned past, not stored.
+  bool matched = true, subtree_root = false;
+  const bool decided = filter && !keep_depth && filter->by_tag_only();
+  if (decided) {
+    matched = filter->tags.count(dom->tag);
+  }
   // skip whitespaces
   skip_whitespaces();
   if (is_alpha_num(read) || read == '_' || read == '!') {
     // read the attributes
-    read_attributes(dom);
+    read_attributes(dom, matched);
   }
   // skip non-terminating read character, now that it contains '>'
   // svg tags might be different to parse now.
@@ -287,20 +353,103 @@ dom_element* html_parser::read_tags(dom_element *parent_dom, const char was_prev
   if (!dom->is_non_terminating) {
     dom->is_non_terminating = is_non_terminating_str(dom->tag);
   }
+  // else decide whether the filter keeps this element, now that attributes are known.
+  if (filter && !keep_depth && !decided) {
+    subtree_root = filter->is_subtree_root(*dom);
+    matched = subtree_root || filter->matches(*dom);
+  }
+  keep_depth += subtree_root;
+  const bool preserves = dom->tag == "pre";
+  preserve_depth += preserves;
+  if (++depth > depth_budget) {
+    // the element is kept, without its content.
+    halt(parse_status::depth_limit);
+  }
+  const uint64_t content_begin = total_character - 1;
   if (dom->is_non_terminating) {
-    return dom;
+    // nothing to read inside.
   }
   else if (is_pure_text_tag(dom->tag)) {
-    // handle this differently
-    pure_text_tag_parser(dom);
+    // handle this differently. The text of a raw text element the filter
+    // rejects is only scanned: the element has no children to keep.
+    pure_text_tag_parser(dom, parse_policy::build_text && matched);
+    dom->content_begin = content_begin - dom->source_begin;
   } else {
-    read_innerhtml(dom);
+    read_innerhtml(dom, matched && (!filter || filter->keep_text));
+    dom->content_begin = content_begin - dom->source_begin;
+  }
+  keep_depth -= subtree_root;
+  preserve_depth -= preserves;
+  --depth;
+  // offsets of the children become relative to this element.
+  dom->source_length = total_character - 1 - dom->source_begin;
+  for (auto &x: dom->children) {
+    x->source_begin -= dom->source_begin;
+  }
+  // neither matched, nor an ancestor of a kept element: drop it.
+  if (!matched && dom->children.empty()) {
+    recycle_node(dom);
+    return nullptr;
   }
+  dom->order_end = next_order;
   return dom;
 }
 
-void html_parser::read_innerhtml(dom_element *dom) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::recycle_node(dom_element *dom) {
+  for (auto &x: dom->child_nodes) {
+    recycle_node(x);
+  }
+  dom->child_nodes.clear();
+  dom->children.clear();
+  spare_nodes.push_back(dom);
+}
+
+/**
+ * @brief check whether a text holds only whitespace.
+ * @param text text to check
+ * @returns true if blank
+ */
+static inline bool is_blank(const std::string &text) {
+  for (auto c: text) {
+    if (c != ' ' && c != '\n' && c != '\t' && c != '\r' && c != '\f') return false;
+  }
+  return true;
+}
+
+template <typename parse_policy>
+bool basic_html_parser<parse_policy>::follows_inline(const dom_element *dom) const {
+  for (size_t i = dom->child_nodes.size() - 1; i-- > 0;) {
+    const dom_element *x = dom->child_nodes[i];
+    if (x->is_comment) continue;
+    return x->is_text_node || inline_elem.count(x->tag);
+  }
+  return inline_elem.count(dom->tag);
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::drop_blank(dom_element *dom, dom_element *text) {
+  // only comments and the element that ends the run can follow it.
+  size_t i = dom->child_nodes.size();
+  while (i-- > 0 && dom->child_nodes[i] != text) { }
+  // a neighbour keeps the run as a space, so that words stay apart in innerText.
+  if (i > 0) {
+    dom->child_nodes[i - 1]->space_after = true;
+  } else if (i + 1 < dom->child_nodes.size()) {
+    dom->child_nodes[i + 1]->space_before = true;
+  } else {
+    // the only child: nothing to hold it.
+    return;
+  }
+  dom->child_nodes.erase(dom->child_nodes.begin() + i);
+  recycle_node(text);
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::read_innerhtml(dom_element *dom, const bool keep_text) {
   bool is_tag_closed = false;
+  // whitespace-only text that goes unless inline content follows it.
+  dom_element *pending_blank = nullptr;
   while (read != EOF && !is_tag_closed) {
     if (dom->is_head) {
       skip_whitespaces();
@@ -314,7 +463,8 @@ void html_parser::read_innerhtml(dom_element *dom) {
           // just to verify that this tag is ended
           read = read_char();
           skip_whitespaces();
-          std::string tag_ends = "";
+          std::string &tag_ends = tag_scratch;
+          tag_ends.clear();
           while (is_alpha_num(read) || read == '-' || read == '_' || read == ':') {
             tag_ends.push_back(char_to_lowercase(read));
             read = read_char();
@@ -336,9 +486,18 @@ void html_parser::read_innerhtml(dom_element *dom) {
           if (!is_a_whitespace(read) && is_alpha_num(read) || read == '!') {
             // Adding new tag name
             // DBGLN("Adding new tag instantly");
-            dom_element *d = read_tags(dom, read);
-            dom->child_nodes.emplace_back(d);
-            dom->children.emplace_back(d);
+            dom_element *d = read_tags(dom, read, comment_is_kept(keep_text));
+            if (d && d->tag.size()) {
+              dom->child_nodes.emplace_back(d);
+              dom->children.emplace_back(d);
+              if (pending_blank && !d->is_comment) {
+                if (!inline_elem.count(d->tag)) drop_blank(dom, pending_blank);
+                pending_blank = nullptr;
+              }
+            } else if (d) {
+              // the input ended (or a limit was hit) before the tag name.
+              recycle_node(d);
+            }
           }
         }
         break;
@@ -346,32 +505,63 @@ void html_parser::read_innerhtml(dom_element *dom) {
       default: {
         // read the text till tag does not appear in the tag
         // std::cout << "text tag\n";
-        dom_element *child_node = new dom_element(dom);
+        if (!text_is_kept(keep_text)) {
+          // filtered out: scan to the next tag without building a node.
+          while (read != '<' && read != EOF) {
+            read = read_char();
+          }
+          break;
+        }
+        dom_element *child_node = create_node(dom);
+        if (!child_node) {
+          break;
+        }
         child_node->is_text_node = true;
         dom->child_nodes.emplace_back(child_node);
         std::string &innertext_ref = dom->child_nodes.back()->innertext = "";
-        while (read != '<' && read != EOF) {
+        while (read != '<' && read != EOF && text_fits(innertext_ref)) {
           innertext_ref.push_back(read);
           read = read_char();
         }
+        pending_blank = nullptr;
+        if (whitespace != whitespace_mode::keep && !preserve_depth && is_blank(innertext_ref)) {
+          innertext_ref.assign(1, ' ');
+          if (whitespace == whitespace_mode::drop && !follows_inline(dom)) pending_blank = child_node;
+        }
         break;
       }
     }
   }
+  // the end of an inline element continues the run around it.
+  if (pending_blank && !inline_elem.count(dom->tag)) {
+    drop_blank(dom, pending_blank);
+  }
 }
 
-void html_parser::javascript_parser(dom_element *dom) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::javascript_parser(dom_element *dom, const bool build) {
   bool valid_final_tag = false;
-  dom->child_nodes.push_back(new dom_element(dom));
-  std::string &innertext_ref = dom->child_nodes.back()->innertext = "";
-  dom->child_nodes.back()->is_text_node = true;
+  std::string *text_target = &text_scratch;
+  if (build) {
+    dom_element *text = create_node(dom);
+    if (!text) {
+      return;
+    }
+    dom->child_nodes.push_back(text);
+    text->is_text_node = true;
+    text_target = &text->innertext;
+  }
+  // the text is needed while reading, to follow strings and comments.
+  std::string &innertext_ref = *text_target = "";
   while (!valid_final_tag) {
     // these characters can impact the nature of parsing the
     // html file.
-    while (read != '<' && read != '\'' && read != '"' && read != '`' && read != '/') {
+    while (read != EOF && read != '<' && read != '\'' && read != '"' && read != '`' && read != '/' &&
+      text_fits(innertext_ref)) {
       innertext_ref.push_back(read);
       read = read_char();
     }
+    RETURN_IF_FILE_ENDED(read, "Error: file end while reading <script>");
     // DBGLN("Break, found " << read);
     switch(read) {
       // It might be the case of:
@@ -379,7 +569,8 @@ void html_parser::javascript_parser(dom_element *dom) {
       // B: template, detect the closing or template
       // and check if script is closed.
       case '<': {
-        std::string check_tag = "";
+        std::string &check_tag = tag_scratch;
+        check_tag.clear();
         // currently read is '<', skip and check if it ends
         read = read_char();
         if (read == '/') {
@@ -420,11 +611,11 @@ void html_parser::javascript_parser(dom_element *dom) {
         while (read != EOF && !valid_string) {
           read = read_char();
           // read till the end of quote.
-          while (read != EOF && read != string_quotes) {
+          while (read != EOF && read != string_quotes && text_fits(innertext_ref)) {
             innertext_ref.push_back(read);
             read = read_char();
           }
-          EXIT_IF_FILE_ENDED(read, "Error in <script> reading, file end without closing inv comma")
+          RETURN_IF_FILE_ENDED(read, "Error in <script> reading, file end without closing inv comma")
           // if there is not a delimiter, then stop
           // otherwise continue the steps
           if (innertext_ref.back() != '\\') {
@@ -443,7 +634,7 @@ void html_parser::javascript_parser(dom_element *dom) {
       case '/': {
         // comment if the previous character
         // is not a delimiter.
-        if (innertext_ref.back() != '\\') {
+        if (innertext_ref.empty() || innertext_ref.back() != '\\') {
           // skip the character.
           read = read_char();
           if (read == '/') {
@@ -451,14 +642,15 @@ void html_parser::javascript_parser(dom_element *dom) {
             innertext_ref += "/";
             bool done = false;
             while (!done) {
-              while (read != EOF && read != '\n' && read != '<') {
+              while (read != EOF && read != '\n' && read != '<' && text_fits(innertext_ref)) {
                 innertext_ref.push_back(read);
                 read = read_char();
               }
-              EXIT_IF_FILE_ENDED(read, "Error: file end while reading single line comment in script");
+              RETURN_IF_FILE_ENDED(read, "Error: file end while reading single line comment in script");
               // add newline character, but exit from the logic.
               if (read == '<') {
-                std::string check_tag = "";
+                std::string &check_tag = tag_scratch;
+                check_tag.clear();
                 // currently read is '<', skip and check if it ends
                 read = read_char();
                 if (read == '/') {
@@ -494,11 +686,11 @@ void html_parser::javascript_parser(dom_element *dom) {
             read = read_char();
             bool end_of_comment = false;
             while (!end_of_comment) {
-              while (read != EOF && read != '*' && read != '<') {
+              while (read != EOF && read != '*' && read != '<' && text_fits(innertext_ref)) {
                 innertext_ref.push_back(read);
                 read = read_char();
               }
-              EXIT_IF_FILE_ENDED(read, "Error: file end while reading multiline comment in script");
+              RETURN_IF_FILE_ENDED(read, "Error: file end while reading multiline comment in script");
               if (read == '*') {
                 read = read_char();
                 if (read == '/') {
@@ -511,7 +703,8 @@ void html_parser::javascript_parser(dom_element *dom) {
                   innertext_ref += "*";
                 }
               } else if(read == '<') {
-                std::string check_tag = "";
+                std::string &check_tag = tag_scratch;
+                check_tag.clear();
                 // currently read is '<', skip and check if it ends
                 read = read_char();
                 if (read == '/') {
@@ -548,22 +741,33 @@ void html_parser::javascript_parser(dom_element *dom) {
   }
 }
 
-void html_parser::pure_text_tag_parser(dom_element *dom) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::pure_text_tag_parser(dom_element *dom, const bool build) {
   // currently, read has skipped the > sign, 
   bool valid_final_tag = false;
   if (dom->tag.size() == 6 && dom->tag == "script") {
     // parse the inner text differently
-    return javascript_parser(dom);
+    return javascript_parser(dom, build);
   } else {
-    dom->child_nodes.push_back(new dom_element(dom));
-    std::string &innertext_ref = dom->child_nodes.back()->innertext = "";
-    dom->child_nodes.back()->is_text_node = true;
+    std::string *text_target = &text_scratch;
+    if (build) {
+      dom_element *text = create_node(dom);
+      if (!text) {
+        return;
+      }
+      dom->child_nodes.push_back(text);
+      text->is_text_node = true;
+      text_target = &text->innertext;
+    }
+    std::string &innertext_ref = *text_target = "";
     while (!valid_final_tag) {
-      while (read != EOF && read != '<') {
+      while (read != EOF && read != '<' && text_fits(innertext_ref)) {
         innertext_ref.push_back(read);
         read = read_char();
       }
-      std::string check_tag = "";
+      RETURN_IF_FILE_ENDED(read, "Error: file end while reading <" + dom->tag + ">");
+      std::string &check_tag = tag_scratch;
+      check_tag.clear();
       // currently read is '<', skip and check if it ends
       read = read_char();
       if (read == '/') {
@@ -591,7 +795,12 @@ void html_parser::pure_text_tag_parser(dom_element *dom) {
   }
 }
 
-html_parser::html_parser(const char *path) {
+template <typename parse_policy>
+basic_html_parser<parse_policy>::basic_html_parser(const char *path): filter(nullptr), keep_depth(0), next_order(0),
+  numbering_root(nullptr), editable(false),
+  reparsing(false), reparse_escaped(false), head_element(nullptr), body_element(nullptr),
+  whitespace(whitespace_mode::keep), preserve_depth(0) {
+  set_limits(nullptr);
   read = '\0';
   total_character = character_in_a_line = line_number = 0;
   head_dom_hit = body_dom_hit = false;
@@ -605,28 +814,444 @@ html_parser::html_parser(const char *path) {
   document = read_file();
 }
 
-dom_element *html_parser::parse_html(const char *path) {
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::load_file(const char *path) {
+  FILE *iptr = fopen(path, "rb");
+  if (!iptr) {
+    printf("Error while reading file %s\n", path);
+    perror("");
+    exit(-1);
+  }
+  if (!rd) {
+    rd = new reader <FILE*>();
+  }
+  rd->load(iptr, F_READING);
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::reset() {
   read = '\0';
   if (document) {
-    delete document;
+    recycle_node(document);
     document = nullptr;
   }
-  if (rd) {
-    delete rd;
-    rd = nullptr;
-  }
+  if (hashes) hashes->clear();
   total_character = character_in_a_line = line_number = 0;
   head_dom_hit = body_dom_hit = false;
-  FILE *iptr = fopen(path, "rb");
-  if (!iptr) {
-    printf("Error while reading file %s\n", path);
-    perror("");
-    exit(-1);
+  keep_depth = preserve_depth = 0;
+  editable = false;
+  head_element = body_element = nullptr;
+  set_limits(limits);
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::set_limits(const parse_limits *limits) {
+  this->limits = limits;
+  stop_reason = parse_status::complete;
+  halted = false;
+  nodes_built = 0;
+  depth = 0;
+  byte_budget = node_budget = text_budget = UINT64_MAX;
+  depth_budget = attribute_budget = UINT32_MAX;
+  next_check = UINT64_MAX;
+  if (!limits) {
+    return;
   }
-  rd = new reader <FILE*>(iptr, 0);
+  if (limits->max_bytes) byte_budget = limits->max_bytes;
+  if (limits->max_nodes) node_budget = limits->max_nodes;
+  if (limits->max_text_length) text_budget = limits->max_text_length;
+  if (limits->max_depth) depth_budget = limits->max_depth;
+  if (limits->max_attributes) attribute_budget = limits->max_attributes;
+  next_check = total_character;
+}
+
+template <typename parse_policy>
+bool basic_html_parser<parse_policy>::within_limits() {
+  if (halted) {
+    return false;
+  }
+  if (total_character >= byte_budget) {
+    halt(parse_status::byte_limit);
+    return false;
+  }
+  next_check = byte_budget;
+  if (limits && limits->deadline != std::chrono::steady_clock::time_point::max()) {
+    if (std::chrono::steady_clock::now() >= limits->deadline) {
+      halt(parse_status::deadline);
+      return false;
+    }
+    next_check = std::min(byte_budget, total_character + std::max<uint32_t>(limits->clock_interval, 1));
+  }
+  return true;
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::halt(const parse_status reason) {
+  if (!halted) {
+    halted = true;
+    stop_reason = reason;
+  }
+  // every read from now on sees the end of the input.
+  next_check = 0;
+  read = EOF;
+}
+
+template <typename parse_policy>
+void basic_html_parser<parse_policy>::input_ended(const std::string &err_message) {
+  if (halted) {
+    // not an error of the input: a limit cut it.
+    return;
+  }
+  if (stop_reason == parse_status::complete) {
+    stop_reason = parse_status::unexpected_end;
+  }
+  std::cerr << err_message << "\n";
+  std::cerr << "\tat line " << line_number << ":" << character_in_a_line << '\n';
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html(const char *path) {
+  reset();
+  load_file(path);
   return document = read_file();
 }
 
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html(const char *path, const parse_limits &limits) {
+  this->limits = &limits;
+  parse_html(path);
+  // the status stays until the next parse.
+  const parse_status reason = stop_reason;
+  set_limits(nullptr);
+  stop_reason = reason;
+  return document;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse(const char *data, const size_t length, const bool borrow) {
+  reset();
+  if (!rd) {
+    rd = new reader <FILE*>();
+  }
+  if (borrow) {
+    rd->load_memory(data, length);
+  } else {
+    rd->load_copy(data, length);
+  }
+  return document = read_file();
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse(const char *data, const size_t length, const parse_limits &limits,
+  const bool borrow) {
+  this->limits = &limits;
+  parse(data, length, borrow);
+  const parse_status reason = stop_reason;
+  set_limits(nullptr);
+  stop_reason = reason;
+  return document;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html(const char *path, const parse_filter &filter) {
+  this->filter = &filter;
+  parse_html(path);
+  this->filter = nullptr;
+  return document;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html_tokenized(const char *path, const bool pipelined) {
+  reset();
+  load_file(path);
+  html_tokenizer tokenizer(rd);
+  html_tree_builder builder;
+  bool more = true;
+  if (!pipelined) {
+    html_token token;
+    while (more) {
+      more = tokenizer.next(token);
+      builder.consume(token);
+    }
+    document = builder.finish();
+    if (hashes) hashes->hash(document);
+    return document;
+  }
+  spsc_queue<html_token> queue(TOKEN_QUEUE_SIZE);
+  std::thread producer([&queue, &tokenizer]() {
+    bool more = true;
+    while (more) {
+      html_token *slot;
+      while (!(slot = queue.try_reserve())) {
+        std::this_thread::yield();
+      }
+      more = tokenizer.next(*slot);
+      queue.commit();
+    }
+  });
+  while (more) {
+    html_token *slot;
+    while (!(slot = queue.try_front())) {
+      std::this_thread::yield();
+    }
+    more = slot->type != token_type::end_of_file;
+    builder.consume(*slot);
+    queue.pop();
+  }
+  producer.join();
+  document = builder.finish();
+  if (hashes) hashes->hash(document);
+  return document;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_editable_source() {
+  reset();
+  if (!rd) {
+    rd = new reader <FILE*>();
+  }
+  rd->load_memory(editable_source.data(), editable_source.size());
+  document = read_file();
+  document->source_length = editable_source.size();
+  editable = true;
+  return document;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html_editable(const char *path) {
+  reset();
+  load_file(path);
+  // keep the input as the parser sees it: decompressed and in UTF-8.
+  const char *data = nullptr;
+  uint64_t size = 0;
+  if (rd->whole_input(data, size)) {
+    editable_source.assign(data, size);
+  } else {
+    editable_source.clear();
+    char c;
+    while ((c = rd->read_next_char()) != EOF) {
+      editable_source.push_back(c);
+    }
+  }
+  return parse_editable_source();
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::parse_html_editable(const std::string &source) {
+  editable_source = source;
+  return parse_editable_source();
+}
+
+template <typename parse_policy>
+bool basic_html_parser<parse_policy>::holds_head_or_body(const dom_element *dom) const {
+  for (const dom_element *x: { head_element, body_element }) {
+    for (x = x ? x->parent : nullptr; x; x = x->parent) {
+      if (x == dom) return true;
+    }
+  }
+  return false;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::find_edit_target(const uint64_t offset, const uint64_t removed, uint64_t &begin,
+  std::vector<std::pair<dom_element *, size_t>> &path, bool &whole) const {
+  dom_element *node = document;
+  uint64_t node_begin = 0;
+  path.clear();
+  whole = false;
+  while (true) {
+    // children are in source order: find the last one starting before the edit.
+    const std::vector<dom_element *> &list = node->children;
+    size_t low = 0, high = list.size();
+    while (low < high) {
+      const size_t mid = (low + high) / 2;
+      if (node_begin + list[mid]->source_begin <= offset) low = mid + 1;
+      else high = mid;
+    }
+    if (low == 0) break;
+    dom_element *child = list[low - 1];
+    const uint64_t child_begin = node_begin + child->source_begin;
+    const uint64_t child_end = child_begin + child->source_length;
+    if (offset >= child_end || offset + removed > child_end) break;
+    path.emplace_back(child, low - 1);
+    if (!child->content_begin || offset < child_begin + child->content_begin) {
+      // the edit touches the start tag (or a comment): reparse the whole
+      // element, its '<' excluded. An edit of the '<' itself is left to the parent.
+      whole = offset > child_begin;
+      if (!whole) path.pop_back();
+      break;
+    }
+    node = child;
+    node_begin = child_begin;
+  }
+  if (whole) {
+    dom_element *dom = path.back().first;
+    // top level elements are read by read_file, and only a full parse decides
+    // which head or body is flagged.
+    if (dom->parent != document && dom != head_element && dom != body_element && !holds_head_or_body(dom)) {
+      begin = dom->get_source_offset();
+      return dom;
+    }
+    path.pop_back();
+    whole = false;
+  }
+  // otherwise reparse the content of an enclosing element.
+  while (path.size() && holds_head_or_body(path.back().first)) {
+    path.pop_back();
+  }
+  if (path.empty()) return nullptr;
+  begin = path.back().first->get_source_offset();
+  return path.back().first;
+}
+
+template <typename parse_policy>
+dom_element *basic_html_parser<parse_policy>::apply_edit(const uint64_t offset, const uint64_t removed, const std::string &inserted) {
+  if (!editable || offset > editable_source.size() || removed > editable_source.size() - offset) {
+    return nullptr;
+  }
+  uint64_t begin = 0;
+  bool whole = false;
+  std::vector<std::pair<dom_element *, size_t>> path;
+  dom_element *target = find_edit_target(offset, removed, begin, path, whole);
+  editable_source.replace(offset, removed, inserted);
+  if (!target) {
+    return parse_editable_source();
+  }
+  const int64_t delta = static_cast<int64_t>(inserted.size()) - static_cast<int64_t>(removed);
+  const uint64_t expected_end = begin + target->source_length + delta;
+  // parse from the same state a full parse would be in at this point.
+  const uint64_t from = whole ? begin + 1 : begin + target->content_begin;
+  rd->load_memory(editable_source.data() + from, editable_source.size() - from);
+  total_character = from;
+  line_number = character_in_a_line = 0;
+  head_dom_hit = head_element != nullptr;
+  body_dom_hit = body_element != nullptr;
+  reparsing = true;
+  reparse_escaped = false;
+  preserve_depth = 0;
+  for (const dom_element *x = whole ? target->parent : target; x; x = x->parent) {
+    preserve_depth += x->tag == "pre";
+  }
+  read = read_char();
+  dom_element *parent = target->parent;
+  dom_element *fresh = nullptr;
+  if (whole) {
+    // read_innerhtml only reads a tag after '<' followed by one of these.
+    if ((!is_a_whitespace(read) && is_alpha_num(read)) || read == '!') {
+      fresh = read_tags(parent, read, comment_is_kept(true));
+    }
+  } else if ((fresh = create_node(parent))) {
+    fresh->tag = target->tag;
+    fresh->is_head = target->is_head;
+    fresh->is_body = target->is_body;
+    if (is_pure_text_tag(fresh->tag)) {
+      pure_text_tag_parser(fresh, parse_policy::build_text);
+    } else {
+      read_innerhtml(fresh);
+    }
+  }
+  reparsing = false;
+  preserve_depth = 0;
+  // whether the whitespace around an element is dropped depends on its kind.
+  const bool same_kind = !whole || !fresh || whitespace != whitespace_mode::drop ||
+    (fresh->is_comment == target->is_comment && inline_elem.count(fresh->tag) == inline_elem.count(target->tag));
+  // the reparse must stop where the old element stopped, shifted by the
+  // edit: the rest of the document is then parsed exactly as before.
+  if (!fresh || reparse_escaped || !same_kind || total_character - 1 != expected_end) {
+    if (fresh) recycle_node(fresh);
+    return parse_editable_source();
+  }
+  if (whole) {
+    // put the new element in place of the old one.
+    fresh->source_begin = target->source_begin;
+    fresh->space_before = target->space_before;
+    fresh->space_after = target->space_after;
+    for (auto &x: parent->child_nodes) {
+      if (x == target) x = fresh;
+    }
+    parent->children[path.back().second] = fresh;
+    path.back().first = fresh;
+    if (hashes) hashes->forget(target);
+    recycle_node(target);
+    target = fresh;
+    // its own length is already the new one.
+    target->source_length -= delta;
+  } else {
+    for (auto &x: target->child_nodes) {
+      if (hashes) hashes->forget(x);
+      recycle_node(x);
+    }
+    target->child_nodes.swap(fresh->child_nodes);
+    target->children.swap(fresh->children);
+    fresh->child_nodes.clear();
+    fresh->children.clear();
+    recycle_node(fresh);
+    for (auto &x: target->child_nodes) {
+      x->parent = target;
+    }
+    for (auto &x: target->children) {
+      x->source_begin -= begin;
+    }
+  }
+  // the enclosing elements grow by delta and the elements after them move.
+  document->source_length += delta;
+  for (auto &step: path) {
+    dom_element *x = step.first;
+    x->source_length += delta;
+    std::vector<dom_element *> &siblings = x->parent->children;
+    for (size_t i = step.second + 1; i < siblings.size(); ++i) {
+      siblings[i]->source_begin += delta;
+    }
+  }
+  // the new nodes were numbered after the whole document: give the positions
+  // again now, while the document is being changed anyway, so that queries
+  // only read them.
+  document->number_subtree();
+  // only the hashes on the path to the root change.
+  if (hashes) {
+    hashes->invalidate(target);
+    hashes->hash(document);
+  }
+  return target;
+}
+
+template <typename parse_policy>
+memory_usage basic_html_parser<parse_policy>::memory_report() const {
+  memory_usage usage = memory_usage();
+  if (document) {
+    document->memory_report(usage);
+  }
+  if (rd) {
+    uint64_t used, allocated;
+    rd->memory_held(used, allocated);
+    usage.input_buffer.used = used;
+    usage.input_buffer.slack = allocated - used;
+  }
+  for (auto &x: spare_nodes) {
+    memory_usage spare = memory_usage();
+    x->memory_report(spare);
+    usage.spare_nodes.slack += spare.total();
+  }
+  usage.spare_nodes.slack += spare_nodes.capacity() * sizeof(dom_element *);
+  if (hashes) {
+    hashes->memory_report(usage.hashes);
+  }
+  return usage;
+}
+
+template <typename parse_policy>
+basic_html_parser<parse_policy>::~basic_html_parser() {
+  if (document) {
+    delete document;
+  }
+  if (rd) {
+    delete rd;
+  }
+  for (auto &x: spare_nodes) {
+    delete x;
+  }
+}
+
 /**
  * @brief build the set from array<string>
  * @param op array of strings
@@ -640,26 +1265,30 @@ std::unordered_set<std::string> _build_st(const std::vector<std::string> &op) {
   return st_;
 }
 
-const std::unordered_set<std::string> html_parser::st = 
+const std::unordered_set<std::string> html_parser_tables::st = 
         _build_st(std::vector<std::string>({"br", "hr", "img", "input", 
                       "area", "base", "col", "command", "keygen", 
                       "link", "meta", "param", "source", "track", "wbr"}));
 
-const std::unordered_set<std::string> html_parser::inline_elem = 
+const std::unordered_set<std::string> html_parser_tables::inline_elem = 
   _build_st(std::vector<std::string>({"b", "strong", "i", "em", "u", "span",
     "sub", "sup", "bdo", "img", "button", "input", "option", "textarea", 
     "select", "abbr", "code", "script", "label","big", "small", "a", "map",
     "object", "q", "kbd", "samp", "acronym", "dfn"}));
 
-const std::unordered_set<std::string> html_parser::p_text_tag = 
+const std::unordered_set<std::string> html_parser_tables::p_text_tag = 
   _build_st(std::vector<std::string>({"title", "textarea", "script", 
                                       "style"}));
 
+template class basic_html_parser<full_dom_policy>;
+template class basic_html_parser<extraction_policy>;
+template class basic_html_parser<validation_policy>;
+
 #undef DBG
 #undef DBGLN
 #undef DBGSP
 #undef DBGV
 #undef DBGVLN
 #undef DBGVSP
-#undef EXIT_IF_FILE_ENDED
+#undef RETURN_IF_FILE_ENDED
 #undef ERR_MSG
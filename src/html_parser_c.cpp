@@ -0,0 +1,187 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "include/html_parser_c.h"
+#include "include/html_parser.hpp"
+#include "include/xpath.hpp"
+
+/// the C handle: a parser and the document it holds
+struct hp_document {
+  html_parser parser;
+  parse_limits limits;
+  bool failed = false;      /// the last hp_parse returned NULL
+};
+
+static_assert(static_cast<int>(parse_status::deadline) == HP_STATUS_DEADLINE, "hp_status follows parse_status");
+
+static inline const dom_element *dom(const hp_node *node) { return reinterpret_cast<const dom_element *>(node); }
+
+static inline const hp_node *handle(const dom_element *dom) { return reinterpret_cast<const hp_node *>(dom); }
+
+/**
+ * @brief copy a string into memory the caller frees with hp_string_free.
+ * @param s string to copy
+ * @returns allocated copy, nullptr if out of memory
+ */
+static char *export_string(const std::string &s) {
+  char *copy = static_cast<char *>(malloc(s.size() + 1));
+  if (copy) memcpy(copy, s.c_str(), s.size() + 1);
+  return copy;
+}
+
+/**
+ * @brief copy query results to the caller's array.
+ * @param found results
+ * @param out output array
+ * @param capacity size of out
+ * @returns number of results
+ */
+template <typename element_type>
+static size_t export_nodes(const std::vector<element_type *> &found, const hp_node **out, const size_t capacity) {
+  for (size_t i = 0; i < found.size() && i < capacity; ++i) {
+    out[i] = handle(found[i]);
+  }
+  return found.size();
+}
+
+uint32_t hp_abi_version(void) { return HP_ABI_VERSION; }
+
+hp_document *hp_document_create(void) { return new (std::nothrow) hp_document(); }
+
+void hp_document_destroy(hp_document *document) { delete document; }
+
+const hp_node *hp_parse(hp_document *document, const char *data, size_t length, uint32_t flags,
+  const hp_limits *limits) {
+  // no exception may cross the C boundary.
+  document->failed = false;
+  try {
+    const bool borrow = flags & HP_PARSE_BORROW;
+    document->parser.set_whitespace_mode(flags & HP_PARSE_DROP_WHITESPACE ? whitespace_mode::drop :
+      flags & HP_PARSE_COLLAPSE_WHITESPACE ? whitespace_mode::collapse : whitespace_mode::keep);
+    if (!limits) {
+      return handle(document->parser.parse(data, length, borrow));
+    }
+    parse_limits &l = document->limits;
+    l = parse_limits();
+    l.max_bytes = limits->max_bytes;
+    l.max_nodes = limits->max_nodes;
+    l.max_depth = limits->max_depth;
+    l.max_attributes = limits->max_attributes;
+    l.max_text_length = limits->max_text_length;
+    if (limits->timeout_us) l.with_timeout(std::chrono::microseconds(limits->timeout_us));
+    return handle(document->parser.parse(data, length, l, borrow));
+  } catch (...) {
+    document->parser.reset();
+    document->failed = true;
+    return nullptr;
+  }
+}
+
+hp_status hp_document_status(const hp_document *document) {
+  if (document->failed) return HP_STATUS_FAILED;
+  return static_cast<hp_status>(document->parser.status());
+}
+
+const hp_node *hp_document_root(const hp_document *document) { return handle(document->parser.main_element()); }
+
+const char *hp_node_tag(const hp_node *node) { return dom(node)->tag_name().c_str(); }
+
+int hp_node_is_text(const hp_node *node) { return dom(node)->is_a_text_node(); }
+
+int hp_node_is_comment(const hp_node *node) { return dom(node)->is_a_comment(); }
+
+const char *hp_node_text(const hp_node *node, size_t *length) {
+  if (!dom(node)->is_a_text_node() && !dom(node)->is_a_comment()) {
+    if (length) *length = 0;
+    return "";
+  }
+  const std::string_view text = dom(node)->get_text();
+  if (length) *length = text.size();
+  // a view of the node's std::string, so it is terminated and never null.
+  return text.data();
+}
+
+const char *hp_node_attribute(const hp_node *node, const char *name, size_t *length) {
+  try {
+    const std::string key(name);
+    if (!dom(node)->has_attribute(key)) return nullptr;
+    const std::string_view value = dom(node)->get_attribute_view(key);
+    if (length) *length = value.size();
+    return value.data();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+const hp_node *hp_node_parent(const hp_node *node) { return handle(dom(node)->get_parent()); }
+
+size_t hp_node_child_count(const hp_node *node) { return dom(node)->get_child_nodes().size(); }
+
+const hp_node *hp_node_child(const hp_node *node, size_t index) {
+  const std::vector<dom_element *> &list = dom(node)->get_child_nodes();
+  return index < list.size() ? handle(list[index]) : nullptr;
+}
+
+char *hp_node_inner_text(const hp_node *node) {
+  try {
+    return export_string(dom(node)->innerText());
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+char *hp_node_inner_html(const hp_node *node, int minified) {
+  try {
+    return export_string(minified ? dom(node)->minified_innerHTML() : dom(node)->innerHTML());
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void hp_string_free(char *s) { free(s); }
+
+const hp_node *hp_get_element_by_id(const hp_node *node, const char *id) {
+  try {
+    return handle(dom(node)->get_element_by_id(id));
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+size_t hp_get_elements_by_tag_name(const hp_node *node, const char *tag, const hp_node **out, size_t capacity) {
+  // the range walks the tree without allocating, but the name is copied.
+  try {
+    size_t found = 0;
+    for (const dom_element *x: dom(node)->elements_by_tag_name(tag)) {
+      if (found < capacity) out[found] = handle(x);
+      ++found;
+    }
+    return found;
+  } catch (...) {
+    return static_cast<size_t>(-1);
+  }
+}
+
+size_t hp_get_elements_by_class_name(const hp_node *node, const char *class_name, const hp_node **out,
+  size_t capacity) {
+  try {
+    size_t found = 0;
+    for (const dom_element *x: dom(node)->elements_by_class_name(class_name)) {
+      if (found < capacity) out[found] = handle(x);
+      ++found;
+    }
+    return found;
+  } catch (...) {
+    return static_cast<size_t>(-1);
+  }
+}
+
+size_t hp_select(const hp_node *node, const char *expression, const hp_node **out, size_t capacity) {
+  try {
+    const xpath path(expression);
+    if (!path.valid()) return static_cast<size_t>(-1);
+    return export_nodes(path.select(dom(node)), out, capacity);
+  } catch (...) {
+    return static_cast<size_t>(-1);
+  }
+}
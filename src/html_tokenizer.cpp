@@ -0,0 +1,209 @@
+#include "include/html_tokenizer.hpp"
+#include "include/html_parser.hpp"
+
+html_tokenizer::html_tokenizer(reader <FILE *>*rd):
+  rd(rd), position(UINT64_MAX), st(state::data) {
+  // position wraps to 0 with the first character.
+  read_char();
+}
+
+void html_tokenizer::read_text(html_token &token) {
+  token.type = token_type::text;
+  while (read != EOF && read != '<') {
+    token.value.push_back(read);
+    read_char();
+  }
+}
+
+void html_tokenizer::read_comment(html_token &token) {
+  token.type = token_type::comment;
+  std::string &value = token.value;
+  if (read == '-') {
+    read_char();
+    if (read == '-') {
+      // "<!--": read till "-->"
+      read_char();
+      while (read != EOF) {
+        if (read == '>' && value.size() >= 2 && value[value.size() - 1] == '-' && value[value.size() - 2] == '-') {
+          value.resize(value.size() - 2);
+          read_char();
+          return;
+        }
+        value.push_back(read);
+        read_char();
+      }
+      return;
+    }
+    value.push_back('-');
+  }
+  // "<!doctype ...>" or a bogus comment: read till '>'
+  while (read != EOF && read != '>') {
+    value.push_back(read);
+    read_char();
+  }
+  if (read == '>') read_char();
+}
+
+void html_tokenizer::read_in_tag(html_token &token) {
+  while (true) {
+    skip_whitespaces();
+    if (read == '/') {
+      read_char();
+      if (read != '>') continue;
+      token.self_closing = true;
+    }
+    if (read == '>' || read == EOF) {
+      token.type = token_type::start_tag_close;
+      if (read == '>') read_char();
+      st = raw_tag.size() ? state::raw : state::data;
+      return;
+    }
+    break;
+  }
+  token.type = token_type::attribute;
+  if (read == '=') {
+    // a name starting with '=' keeps it, as in the HTML spec.
+    token.name.push_back(read);
+    read_char();
+  }
+  while (is_name_char(read)) {
+    token.name.push_back(char_to_lowercase(read));
+    read_char();
+  }
+  skip_whitespaces();
+  if (read != '=') return;
+  read_char();
+  skip_whitespaces();
+  if (read == '"' || read == '\'') {
+    const char quote = read;
+    read_char();
+    while (read != EOF && read != quote) {
+      token.value.push_back(read);
+      read_char();
+    }
+    if (read == quote) read_char();
+  } else {
+    while (read != EOF && !is_a_whitespace(read) && read != '>') {
+      token.value.push_back(read);
+      read_char();
+    }
+  }
+}
+
+void html_tokenizer::read_raw_text(html_token &token) {
+  token.type = token_type::raw_text;
+  std::string &value = token.value;
+  while (read != EOF) {
+    while (read != EOF && read != '<') {
+      value.push_back(read);
+      read_char();
+    }
+    if (read == EOF) break;
+    // check whether this is the end tag of the raw text element.
+    const size_t mark = value.size();
+    const uint64_t end_begin = position;
+    value.push_back(read);
+    read_char();
+    if (read != '/') continue;
+    value.push_back(read);
+    read_char();
+    size_t i = 0;
+    while (i < raw_tag.size() && char_to_lowercase(read) == raw_tag[i]) {
+      value.push_back(read);
+      read_char();
+      ++i;
+    }
+    if (i == raw_tag.size() && (read == EOF || read == '>' || read == '/' || is_a_whitespace(read))) {
+      // end tag found, it is produced by the next call.
+      value.resize(mark);
+      raw_end_begin = end_begin;
+      st = state::raw_end;
+      return;
+    }
+  }
+  st = state::data;
+}
+
+bool html_tokenizer::next(html_token &token) {
+  token.name.clear();
+  token.value.clear();
+  token.self_closing = false;
+  token.begin = position;
+  switch (st) {
+    case state::in_tag:
+      read_in_tag(token);
+      break;
+    case state::raw:
+      read_raw_text(token);
+      token.end = (st == state::raw_end) ? raw_end_begin : position;
+      return true;
+    case state::raw_end:
+      // "</tag" is already consumed by read_raw_text.
+      token.type = token_type::end_tag;
+      token.name = raw_tag;
+      token.begin = raw_end_begin;
+      while (read != EOF && read != '>') read_char();
+      if (read == '>') read_char();
+      raw_tag.clear();
+      st = state::data;
+      break;
+    default:
+      if (read == EOF) {
+        token.type = token_type::end_of_file;
+        token.end = position;
+        return false;
+      }
+      if (read != '<') {
+        read_text(token);
+        break;
+      }
+      read_char();
+      if (read == '/') {
+        read_char();
+        if (is_alpha(read)) {
+          token.type = token_type::end_tag;
+          while (is_name_char(read)) {
+            token.name.push_back(char_to_lowercase(read));
+            read_char();
+          }
+          while (read != EOF && read != '>') read_char();
+          if (read == '>') read_char();
+        } else {
+          // "</" without a tag name is a bogus comment.
+          token.type = token_type::comment;
+          while (read != EOF && read != '>') {
+            token.value.push_back(read);
+            read_char();
+          }
+          if (read == '>') read_char();
+        }
+      } else if (read == '!') {
+        read_char();
+        read_comment(token);
+      } else if (read == '?') {
+        token.type = token_type::comment;
+        while (read != EOF && read != '>') {
+          token.value.push_back(read);
+          read_char();
+        }
+        if (read == '>') read_char();
+      } else if (is_alpha(read)) {
+        token.type = token_type::start_tag;
+        while (is_name_char(read)) {
+          token.name.push_back(char_to_lowercase(read));
+          read_char();
+        }
+        if (html_parser::p_text_tag.find(token.name) != html_parser::p_text_tag.end()) {
+          raw_tag = token.name;
+        }
+        st = state::in_tag;
+      } else {
+        // a lone '<' is text.
+        token.value.push_back('<');
+        read_text(token);
+      }
+      break;
+  }
+  token.end = position;
+  return true;
+}
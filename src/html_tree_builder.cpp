@@ -0,0 +1,106 @@
+#include "include/html_tree_builder.hpp"
+#include "include/html_parser.hpp"
+
+html_tree_builder::html_tree_builder():
+  document(new dom_element(nullptr)), pending(nullptr),
+  head_dom_hit(false), body_dom_hit(false) {
+  open_elements.push_back(document);
+}
+
+void html_tree_builder::set_class(dom_element *dom, const std::string &value) {
+  dom->_class = value;
+  size_t i = 0;
+  const size_t sz = value.size();
+  while (i < sz) {
+    while (i < sz && (value[i] == ' ' || value[i] == '\n' || value[i] == '\t')) { ++i; }
+    dom->class_list.emplace_back("");
+    std::string &classname = dom->class_list.back();
+    while (i < sz && value[i] != ' ' && value[i] != '\n' && value[i] != '\t') { classname.push_back(value[i++]); }
+  }
+}
+
+void html_tree_builder::consume(const html_token &token) {
+  dom_element *current = open_elements.back();
+  switch (token.type) {
+    case token_type::start_tag: {
+      dom_element *dom = new dom_element(current);
+      dom->tag = token.name;
+      if (!head_dom_hit) {
+        dom->is_head = head_dom_hit = dom->tag == "head";
+      }
+      if (!body_dom_hit) {
+        dom->is_body = body_dom_hit = dom->tag == "body";
+      }
+      current->child_nodes.push_back(dom);
+      current->children.push_back(dom);
+      pending = dom;
+      break;
+    }
+    case token_type::attribute: {
+      if (!pending) break;
+      auto iter = pending->attr.emplace(token.name, token.value);
+      if (!iter.second) break;
+      if (token.name.size() == 5 && token.name == "class") {
+        set_class(pending, token.value);
+      } else if (token.name.size() == 2 && token.name == "id") {
+        pending->id = token.value;
+      }
+      break;
+    }
+    case token_type::start_tag_close: {
+      if (!pending) break;
+      pending->is_non_terminating = token.self_closing ||
+        html_parser::st.find(pending->tag) != html_parser::st.end();
+      if (!pending->is_non_terminating) {
+        open_elements.push_back(pending);
+      }
+      pending = nullptr;
+      break;
+    }
+    case token_type::end_tag: {
+      // close up to the matching open element, ignore stray end tags.
+      for (size_t i = open_elements.size() - 1; i > 0; --i) {
+        if (open_elements[i]->tag == token.name) {
+          open_elements.resize(i);
+          break;
+        }
+      }
+      break;
+    }
+    case token_type::comment: {
+      dom_element *dom = new dom_element(current);
+      dom->tag = "#comment";
+      dom->is_comment = true;
+      dom->innertext = token.value;
+      current->child_nodes.push_back(dom);
+      current->children.push_back(dom);
+      break;
+    }
+    case token_type::text:
+    case token_type::raw_text: {
+      // text outside of any element is not part of the document.
+      if (current == document) break;
+      dom_element *dom = new dom_element(current);
+      dom->is_text_node = true;
+      dom->innertext = token.value;
+      current->child_nodes.push_back(dom);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+dom_element *html_tree_builder::finish() {
+  dom_element *dom = document;
+  dom->number_subtree();
+  document = new dom_element(nullptr);
+  open_elements.assign(1, document);
+  pending = nullptr;
+  head_dom_hit = body_dom_hit = false;
+  return dom;
+}
+
+html_tree_builder::~html_tree_builder() {
+  delete document;
+}
@@ -0,0 +1,46 @@
+#ifndef __CORPUS_RUNNER_HPP_H_
+#define __CORPUS_RUNNER_HPP_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Parses many files in one process: reader threads prefetch the
+ * files into the page cache while parser threads, each with its own
+ * reused html_parser, consume them. Outputs are written in input order or
+ * as soon as they are ready, and throughput/latency is reported at the end.
+ */
+class corpus_runner {
+public:
+  enum class output_mode { text, html, stats };
+
+  /**
+   * @brief constructor
+   * @param source a directory (walked recursively) or a file with one path per line
+   */
+  corpus_runner(const std::string &source);
+
+  unsigned parser_threads;   /// number of parser threads
+  unsigned reader_threads;   /// number of prefetching threads
+  unsigned prefetch_depth;   /// files prefetched ahead of the parsers
+  output_mode output;        /// what is written for each file
+  bool ordered;              /// write outputs in input order
+
+  /**
+   * @brief run the whole corpus, writing outputs to stdout and the summary to stderr.
+   * @returns number of files that could not be read.
+   */
+  size_t run();
+
+private:
+  std::vector<std::string> paths;
+
+  /**
+   * @brief collect regular files below a directory.
+   * @param dir directory to walk
+   * @returns void
+   */
+  void collect_directory(const std::string &dir);
+};
+
+#endif
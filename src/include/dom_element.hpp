@@ -2,15 +2,86 @@
 #ifndef __DOM_ELEMENT_HPP_H_
 #define __DOM_ELEMENT_HPP_H_
 #include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <ostream>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
-class html_parser;
+template <typename parse_policy> class basic_html_parser;
+class frozen_document;
+class string_pool;
+class subtree_hashes;
+struct execution_policy;
+
+/**
+ * @brief bytes of one kind of storage: in use, and allocated but unused.
+ */
+struct memory_category {
+  size_t used;    /// bytes holding data
+  size_t slack;   /// capacity minus size, in bytes
+};
+
+/**
+ * @brief memory held by a document, broken down by category.
+ * String bytes only count heap storage, short strings kept inline in the
+ * std::string object are part of the node struct. Hash map overhead is an
+ * estimate of the node and bucket allocations of the standard library.
+ */
+struct memory_usage {
+  memory_category node_structs;  /// sizeof(dom_element) per node, document order positions included
+  memory_category child_nodes;   /// child_nodes vector storage
+  memory_category children;      /// children vector storage
+  memory_category tag;           /// tag strings
+  memory_category text;          /// innertext strings (text and comments)
+  memory_category attributes;    /// attr maps: nodes, buckets, keys and values
+  memory_category class_list;    /// class_list vector storage and class names
+  memory_category id_class;      /// id and _class copies of the attributes
+  memory_category input_buffer;  /// reader buffers, filled by html_parser
+  memory_category spare_nodes;   /// parser nodes kept for reuse, filled by html_parser
+  memory_category hashes;        /// structural hash table, filled by html_parser when hashing
+
+  /**
+   * @brief add up a value over every category, each named once here.
+   * @param value function of a memory_category
+   * @returns sum over the categories
+   */
+  template <typename value_type>
+  inline size_t sum(const value_type &value) const {
+    return value(node_structs) + value(child_nodes) + value(children) + value(tag) + value(text) +
+      value(attributes) + value(class_list) + value(id_class) + value(input_buffer) + value(spare_nodes) +
+      value(hashes);
+  }
+
+  /**
+   * @brief sum of all categories.
+   * @returns bytes in use plus slack
+   */
+  inline size_t total() const {
+    return sum([](const memory_category &c) { return c.used + c.slack; });
+  }
+
+  /**
+   * @brief sum of the slack of all categories.
+   * @returns bytes allocated but unused
+   */
+  inline size_t total_slack() const {
+    return sum([](const memory_category &c) { return c.slack; });
+  }
+};
 
 // Cinor mhanges yaya baga!;
 class dom_element {
-  friend class html_parser;
+  template <typename parse_policy> friend class basic_html_parser;
+  friend class html_tree_builder;
+  friend class frozen_document;
+  friend class query_batch;
+  friend class xpath;
+  friend class versioned_document;
+  friend class subtree_hashes;
   std::vector<dom_element*> child_nodes;  /// list of DOM element (including text nodes)
   std::vector<dom_element*> children;     /// list of children reference (excluding text nodes)
   bool is_text_node;                      /// boolean for text node.
@@ -18,12 +89,20 @@ class dom_element {
   bool is_non_terminating;                /// is non terminating tag.
   bool is_head;                           /// is a header
   bool is_body;                           /// is a body
+  bool space_before;                      /// a whitespace-only text node before this one was dropped, see whitespace_mode
+  bool space_after;                       /// a whitespace-only text node after this one was dropped
   std::string tag;                        /// tag name
   std::string innertext;                  /// inner text
   std::vector<std::string>class_list;     /// class list
   std::string id;                         /// id of DOM
   std::string _class;                     /// DOM class
   dom_element *parent;                    /// Parent node of this DOM
+  uint64_t source_begin;                  /// offset of the element in the source, relative to the parent's
+  uint64_t source_length;                 /// bytes of source, end tag included
+  uint64_t content_begin;                 /// offset of the content, relative to source_begin, 0 if none
+  const dom_element *order_root;          /// root the positions were given from, nullptr if not numbered
+  uint32_t order_begin;                   /// pre-order position in the tree of order_root
+  uint32_t order_end;                     /// first position after the subtree
   /// attributes of DOM element
   std::unordered_map<std::string, std::string>attr;
 
@@ -33,9 +112,178 @@ class dom_element {
    * @param depth depth of the node
    * @returns void
    */
-  void __construct_innerHTML (std::string &buffop, uint16_t depth = 0);
+  void __construct_innerHTML (std::string &buffop, uint16_t depth = 0) const;
+
+  /**
+   * @brief minified counterpart of __construct_innerHTML, in the same single pass.
+   * @param buffop buffer to output
+   * @param preserve inside pre, textarea or a raw text element: text is written as is
+   * @param following next sibling that is written, nullptr if none: decides
+   *                  whether the end tag can be omitted
+   * @returns void
+   */
+  void __construct_minified_innerHTML(std::string &buffop, const bool preserve, const dom_element *following) const;
+
+  /**
+   * @brief check whether the minifier leaves out a child node: a comment,
+   * or whitespace between block-level nodes.
+   * @param i index in child_nodes
+   * @param preserve whitespace is kept in this element
+   * @returns true if the node is not written
+   */
+  bool minify_drops(const size_t i, const bool preserve) const;
+
+  /**
+   * @brief clears the element so that it can be reused as a fresh node.
+   * The string and vector capacities are kept to avoid reallocation.
+   * @param parent new parent of this DOM element
+   * @returns void
+   */
+  void reset(dom_element *parent);
+
+  /**
+   * @brief number this subtree in pre-order as a tree of its own. Whatever
+   * changes a tree renumbers it at once, so that queries only read positions.
+   * @returns void
+   */
+  void number_subtree();
+
+  /// piece of a query: the node itself, or everything below it
+  struct query_task {
+    const dom_element *node;
+    bool below;
+  };
+
+  /**
+   * @brief add the elements below this DOM matching a query, in document order.
+   * @param match test of an element
+   * @param prune do not search below a matching element
+   * @param dom output list
+   * @returns void
+   */
+  template <typename match_type>
+  void collect(const match_type &match, const bool prune, std::vector<dom_element *> &dom) const;
+
+  /**
+   * @brief split the elements below this DOM into document-order query tasks,
+   * down to a given depth.
+   * @param match test of an element, used to prune at split time
+   * @param prune do not search below a matching element
+   * @param depth levels left to split
+   * @param tasks output list
+   * @returns void
+   */
+  template <typename match_type>
+  void split_query(const match_type &match, const bool prune, const uint16_t depth, std::vector<query_task> &tasks) const;
+
+  /**
+   * @brief evaluate a query under an execution policy.
+   * @param match test of an element
+   * @param prune do not search below a matching element
+   * @param policy sequential or parallel evaluation
+   * @returns matching elements in document order
+   */
+  template <typename match_type>
+  std::vector<dom_element *> run_query(const match_type &match, const bool prune, const execution_policy &policy) const;
 
 public:
+  /// elements yielded by an element_range
+  enum class range_filter : uint8_t { any, tag, class_name };
+
+  /**
+   * @brief forward iterator over the elements below a node in document order
+   * (pre-order), text nodes excluded. It keeps the path to the current node
+   * (parent and index among its siblings) for the first tracked_depth levels,
+   * so it allocates nothing; deeper levels find it again from the parent pointers.
+   * Changing the tree invalidates it.
+   */
+  class element_iterator {
+    friend class dom_element;
+    static const uint32_t tracked_depth = 32;
+    const dom_element *root;
+    const dom_element *current;           /// nullptr at the end
+    range_filter filter;
+    std::string_view name;                /// tag or class name of the filter
+    uint32_t depth;                       /// depth of current below root
+    const dom_element *parent_at[tracked_depth];  /// parent of the ancestor at each depth
+    uint32_t index[tracked_depth];        /// index in its parent's children of the ancestor at each depth
+
+    /**
+     * @brief check whether the current element passes the filter.
+     * @returns true if it is yielded
+     */
+    inline bool matches() const {
+      return filter == range_filter::any || (filter == range_filter::tag ? current->tag == name : current->has_classname(name));
+    }
+
+    /**
+     * @brief move to the next element in pre-order.
+     * @param descend visit the children of the current element
+     * @returns void
+     */
+    void advance(const bool descend);
+
+    /**
+     * @brief move to the first element passing the filter, the current one included.
+     * @returns void
+     */
+    inline void settle() {
+      while (current && !matches()) {
+        advance(true);
+      }
+    }
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef dom_element *value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef dom_element *const *pointer;
+    typedef dom_element *reference;
+
+    element_iterator(): root(nullptr), current(nullptr), filter(range_filter::any), depth(0) {}
+
+    inline dom_element *operator*() const { return const_cast<dom_element *>(current); }
+
+    inline element_iterator &operator++() {
+      // a class match hides its subtree, as in get_elements_by_class_name.
+      advance(filter != range_filter::class_name);
+      settle();
+      return *this;
+    }
+
+    inline element_iterator operator++(int) {
+      element_iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+
+    inline bool operator==(const element_iterator &other) const { return current == other.current; }
+    inline bool operator!=(const element_iterator &other) const { return current != other.current; }
+  };
+
+  /**
+   * @brief lazy, allocation-free range of the elements below a node: elements
+   * are found while iterating, so stopping early skips the rest of the search.
+   */
+  class element_range {
+    const dom_element *root;
+    range_filter filter;
+    std::string_view name;
+
+  public:
+    element_range(const dom_element *root, const range_filter filter, const std::string_view name):
+      root(root), filter(filter), name(name) {}
+
+    element_iterator begin() const;
+    inline element_iterator end() const { return element_iterator(); }
+
+    /**
+     * @brief first element of the range.
+     * @returns the element, nullptr if the range is empty
+     */
+    inline dom_element *first() const { return *begin(); }
+  };
+
   /**
    * @brief constructor 2
    * @param parent the parent of this DOM element
@@ -47,19 +295,58 @@ public:
    * @param classname name of class to check
    * @returns true if class classname exists, else false.
    */
-  inline bool has_classname(const std::string &classname) const {
+  inline bool has_classname(const std::string_view classname) const {
     for (auto &x: class_list) {
       if (classname == x) return true;
     }
     return false;
   }
 
+  /**
+   * @brief get the tag name of the element.
+   * @returns tag name, empty for text nodes.
+   */
+  inline const std::string &tag_name() const { return tag; }
+
+  /**
+   * @brief get the id of the element.
+   * @returns id, empty if the element has none.
+   */
+  inline const std::string &get_id() const { return id; }
+
+  /**
+   * @brief check whether the element has an attribute.
+   * @param attribute_name the name of attribute.
+   * @returns true if the attribute exists, else false.
+   */
+  inline bool has_attribute(const std::string &attribute_name) const {
+    return attr.find(attribute_name) != attr.end();
+  }
+
   /**
    * @brief check if the node is text node.
    * @returns bool
    */
   inline bool is_a_text_node() const { return is_text_node; }
 
+  /**
+   * @brief check if the node is a comment (or a doctype).
+   * @returns bool
+   */
+  inline bool is_a_comment() const { return is_comment; }
+
+  /**
+   * @brief child nodes of this DOM, text nodes and comments included.
+   * @returns list of nodes in document order
+   */
+  inline const std::vector<dom_element *> &get_child_nodes() const { return child_nodes; }
+
+  /**
+   * @brief child elements of this DOM, without the text nodes.
+   * @returns list of elements in document order
+   */
+  inline const std::vector<dom_element *> &get_children() const { return children; }
+
   /**
    * @brief Get pointer to element by id
    * @param id Element id
@@ -75,12 +362,100 @@ public:
     return parent;
   }
   
+  /// bits of compare_document_position, as in the DOM Node interface
+  enum document_position: uint8_t {
+    position_disconnected = 1,            /// the nodes are in different trees
+    position_preceding = 2,               /// the other node comes first
+    position_following = 4,               /// the other node comes after
+    position_contains = 8,                /// the other node is an ancestor
+    position_contained_by = 16,           /// the other node is a descendant
+    position_implementation_specific = 32 /// set with position_disconnected
+  };
+
+  /**
+   * @brief check whether a node is this one or below it, in O(1) from the
+   * positions the parser gives every node. It only reads them: threads can
+   * call it on the same document as long as none changes the document.
+   * @param other node to check, may be nullptr
+   * @returns true if other is this node or a descendant
+   */
+  inline bool contains(const dom_element *other) const {
+    if (!other) return false;
+    return order_root == other->order_root && order_begin <= other->order_begin && other->order_begin < order_end;
+  }
+
+  /**
+   * @brief position of a node relative to this one, in O(1) as contains.
+   * Nodes of different trees get a consistent order, with position_disconnected.
+   * @param other node to compare
+   * @returns 0 if other is this node, else document_position bits
+   */
+  uint8_t compare_document_position(const dom_element *other) const;
+
+  /**
+   * @brief document order of two nodes, in O(1) as contains. Ancestors come first.
+   * @param a first node
+   * @param b second node
+   * @returns true if a comes before b
+   */
+  static inline bool document_order(const dom_element *a, const dom_element *b) {
+    return a->order_root == b->order_root ? a->order_begin < b->order_begin :
+      std::less<const dom_element *>()(a->order_root, b->order_root);
+  }
+
+  /**
+   * @brief sort nodes in document order and remove the duplicates.
+   * @param nodes nodes, sorted in place
+   * @returns void
+   */
+  static void sort_in_document_order(std::vector<dom_element *> &nodes);
+
+  /**
+   * @brief union of two lists in document order, without duplicates, in
+   * linear time.
+   * @param a nodes in document order
+   * @param b nodes in document order
+   * @returns nodes of both lists, in document order
+   */
+  static std::vector<dom_element *> merge_in_document_order(const std::vector<dom_element *> &a,
+    const std::vector<dom_element *> &b);
+
+  /**
+   * @brief offset of the element in the source it was parsed from, by
+   * html_parser::parse_html and parse_html_editable.
+   * @returns offset of the '<' of the element
+   */
+  uint64_t get_source_offset() const;
+
+  /**
+   * @brief length of the source of the element.
+   * @returns bytes from the '<' to the end of the end tag
+   */
+  inline uint64_t get_source_length() const { return source_length; }
+
   /**
    * @brief Get attribute value of the element.
    * @param attribute_name the name of attribute.
    * @returns attribute value.
    */
-  std::string get_attribute_value(const std::string &attribute_name);
+  std::string get_attribute_value(const std::string &attribute_name) const;
+
+  /**
+   * @brief Get attribute value of the element without copying it.
+   * @param attribute_name the name of attribute.
+   * @returns view of the attribute value, valid while the attribute is unchanged;
+   *          empty if the attribute does not exist.
+   */
+  inline std::string_view get_attribute_view(const std::string &attribute_name) const {
+    const auto iter = attr.find(attribute_name);
+    return iter == attr.end() ? std::string_view() : std::string_view(iter->second);
+  }
+
+  /**
+   * @brief text of a text or comment node, without copying it.
+   * @returns view of the text, empty for elements (see innerText).
+   */
+  inline std::string_view get_text() const { return innertext; }
 
   /**
    * @brief get all the elements within this DOM having class name classname
@@ -102,6 +477,33 @@ public:
    */
   std::vector<dom_element *> get_elements_by_tag_name(const std::string &tagname) const;
 
+  /**
+   * @brief get_elements_by_tag_name evaluated under an execution policy.
+   * With a parallel policy the tree is split into document-order subtrees
+   * that are searched on the pool, and the results are merged in document order.
+   * @param tagname name of tag
+   * @param policy sequential_execution or parallel_execution(pool)
+   * @returns list of DOM element pointers, same as the sequential query
+   */
+  std::vector<dom_element *> get_elements_by_tag_name(const std::string &tagname, const execution_policy &policy) const;
+
+  /**
+   * @brief get_elements_by_class_name evaluated under an execution policy.
+   * @param classname name of class to retrieve
+   * @param policy sequential_execution or parallel_execution(pool)
+   * @returns list of DOM element pointers, same as the sequential query
+   */
+  std::vector<dom_element *> get_elements_by_class_name(const std::string &classname, const execution_policy &policy) const;
+
+  /**
+   * @brief full scan: get all the elements within this DOM for which a predicate holds.
+   * @param predicate test of an element, called concurrently with a parallel policy
+   * @param policy sequential_execution or parallel_execution(pool)
+   * @returns list of DOM element pointers in document order
+   */
+  std::vector<dom_element *> get_elements_if(const std::function<bool(const dom_element &)> &predicate,
+    const execution_policy &policy) const;
+
   /**
    * @brief Deletes DOM element from the document: called either via any parent node
    * or the node to delete itself.
@@ -114,13 +516,93 @@ public:
    * @brief returns the inner text
    * @returns the innerText of the element
    */
-  std::string innerText();
+  std::string innerText() const;
+
+  /**
+   * @brief append the inner text to a buffer, which can be reused across calls.
+   * @param buffop output buffer
+   * @returns void
+   */
+  void append_innerText(std::string &buffop) const;
 
   /**
    * @brief parses and returns the innerhtml
    * @returns the innerHTML of this DOM
    */
-  std::string innerHTML();
+  std::string innerHTML() const;
+
+  /**
+   * @brief append the innerHTML to a buffer, which can be reused across calls.
+   * @param buffop output buffer
+   * @returns void
+   */
+  inline void append_innerHTML(std::string &buffop) const { __construct_innerHTML(buffop, 0); }
+
+  /**
+   * @brief innerHTML, minified: whitespace runs collapse to one space and
+   * whitespace between block-level nodes is dropped (not in pre, textarea,
+   * script, style and title), comments are stripped (the doctype and
+   * conditional comments are kept), attribute values are unquoted when
+   * possible and optional end tags (li, p, td, tr, option...) are omitted.
+   * The output is meant for HTML5 parsers such as browsers: html_parser
+   * itself does not imply the omitted end tags.
+   * @returns the minified innerHTML of this DOM
+   */
+  std::string minified_innerHTML() const;
+
+  /**
+   * @brief append the minified innerHTML to a buffer.
+   * @param buffop output buffer
+   * @returns void
+   */
+  inline void append_minified_innerHTML(std::string &buffop) const { __construct_minified_innerHTML(buffop, false, nullptr); }
+
+  /**
+   * @brief lazy range over the elements below this DOM, in document order.
+   * @returns range of every element
+   */
+  inline element_range elements() const { return element_range(this, range_filter::any, std::string_view()); }
+
+  /**
+   * @brief lazy get_elements_by_tag_name: the same elements, found one at a time.
+   * @param tagname name of tag, it must outlive the range
+   * @returns range of the matching elements
+   */
+  inline element_range elements_by_tag_name(const std::string_view tagname) const {
+    return element_range(this, range_filter::tag, tagname);
+  }
+
+  /**
+   * @brief lazy get_elements_by_class_name: the same elements (none below a
+   * match), found one at a time.
+   * @param classname name of class, it must outlive the range
+   * @returns range of the matching elements
+   */
+  inline element_range elements_by_class_name(const std::string_view classname) const {
+    return element_range(this, range_filter::class_name, classname);
+  }
+
+  /**
+   * @brief add the memory held by this element and all its child nodes.
+   * @param usage report to add to, zero-initialize it for a fresh report
+   * @returns void
+   */
+  void memory_report(memory_usage &usage) const;
+
+  /**
+   * @brief copy this element and its child nodes into an immutable,
+   * compact frozen_document (include frozen_document.hpp to use it).
+   * @returns the frozen copy
+   */
+  frozen_document freeze() const;
+
+  /**
+   * @brief freeze into a document that shares its long strings with other
+   * documents through a string pool.
+   * @param strings pool to intern in, it must outlive the frozen copy
+   * @returns the frozen copy
+   */
+  frozen_document freeze(string_pool &strings) const;
 
   /**
    * @brief destructor for dom_element
@@ -0,0 +1,68 @@
+#ifndef __ENCODING_HPP_H_
+#define __ENCODING_HPP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/// encodings recognized at ingest, everything is converted to UTF-8.
+enum class text_encoding : uint8_t { utf8, utf16le, utf16be, windows_1252 };
+
+/// number of bytes scanned for a <meta charset> declaration
+#define ENCODING_PRESCAN_SIZE 1024
+
+/**
+ * @brief guess the encoding of a document from its first bytes: the BOM
+ * first, then a charset in a <meta> tag within ENCODING_PRESCAN_SIZE bytes.
+ * @param data start of the document
+ * @param size number of bytes available
+ * @param bom_length set to the number of BOM bytes to skip
+ * @param declared set to true if a BOM or a meta tag named the encoding
+ * @returns detected encoding, utf8 if nothing was declared.
+ */
+text_encoding sniff_encoding(const char *data, const size_t size, size_t &bom_length, bool &declared);
+
+/**
+ * @brief validate UTF-8, checking 16 bytes at a time while the input is ASCII.
+ * @param data bytes to check
+ * @param size number of bytes
+ * @returns length of the valid prefix, size if everything is valid.
+ */
+size_t validate_utf8(const char *data, const size_t size);
+
+/**
+ * @brief Converts a byte stream to UTF-8. UTF-16 and windows-1252 input may
+ * be split anywhere, a code unit or surrogate pair cut between two calls is
+ * completed by the next call. UTF-8 input is only repaired, and must be
+ * given in one piece. Invalid input is replaced with U+FFFD.
+ */
+class utf8_transcoder {
+  text_encoding from;
+  uint8_t pending_byte;       /// first byte of a UTF-16 unit split between calls
+  bool has_pending_byte;
+  uint16_t high_surrogate;    /// UTF-16 high surrogate waiting for its pair, 0 if none
+
+public:
+  /**
+   * @brief constructor
+   * @param from encoding of the input; utf8 repairs invalid sequences.
+   */
+  utf8_transcoder(const text_encoding from = text_encoding::utf8);
+
+  /**
+   * @brief largest output convert() can produce.
+   * @param size input size
+   * @returns output buffer size to reserve
+   */
+  static inline size_t max_output(const size_t size) { return 3 * size + 8; }
+
+  /**
+   * @brief convert one piece of the input.
+   * @param data input bytes
+   * @param size number of input bytes
+   * @param out output buffer of at least max_output(size) bytes
+   * @returns number of bytes written to out
+   */
+  size_t convert(const char *data, const size_t size, char *out);
+};
+
+#endif
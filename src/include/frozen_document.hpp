@@ -0,0 +1,270 @@
+#ifndef __FROZEN_DOCUMENT_HPP_H_
+#define __FROZEN_DOCUMENT_HPP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dom_element.hpp"
+#include "string_pool.hpp"
+
+struct execution_policy;
+
+/**
+ * @brief Immutable struct-of-arrays copy of a parsed document.
+ * Nodes are numbered in document order (node 0 is the document itself) and
+ * described by parallel arrays: tag atom, parent, first child, next sibling
+ * and end of subtree. Tag, attribute and class names are atoms (indices in a
+ * sorted name table); text, comment and attribute values live in one
+ * character pool. Everything is carved out of a single allocation.
+ * The descendants of a node are the contiguous range (node, subtree_end(node)),
+ * so queries are linear scans over small integer arrays.
+ * With a string_pool, the strings the pool accepts are not copied into the
+ * allocation: they are held in the pool, shared with the other documents.
+ */
+class frozen_document {
+public:
+  typedef uint32_t node_id;
+  static const node_id npos = UINT32_MAX;
+
+  /// view of a string stored in the document
+  struct text_ref {
+    const char *data;
+    size_t size;
+  };
+
+private:
+  enum node_kind : uint8_t { kind_document, kind_element, kind_text, kind_comment };
+  enum node_flag : uint8_t { flag_non_terminating = 1 };
+
+  char *block;                /// the single allocation holding everything below
+  size_t block_size;
+  uint32_t nodes;             /// number of nodes
+  uint32_t atoms;             /// number of distinct tag/attribute/class names
+  uint32_t ids;               /// number of entries in the id index
+
+  text_ref *node_text;        /// text or comment content, per node
+  text_ref *attr_value;       /// attribute values
+  text_ref *atom_name;        /// names, sorted so that an atom can be found by binary search
+  text_ref *id_value;         /// id index, sorted by id value
+  node_id *tag_atom;          /// tag name atom per node, npos for text nodes and the document
+  node_id *parent;            /// parent per node, npos for the document
+  node_id *first_child;       /// first child node (text nodes included), npos if none
+  node_id *next_sibling;      /// next sibling node, npos if none
+  node_id *subtree_end;       /// first node after the subtree of each node
+  uint32_t *attr_begin;       /// attributes of node i are [attr_begin[i], attr_begin[i + 1])
+  uint32_t *attr_name;        /// attribute name atoms
+  uint32_t *class_begin;      /// classes of node i are [class_begin[i], class_begin[i + 1])
+  uint32_t *class_atom;       /// class name atoms
+  node_id *id_node;           /// node of each id index entry
+  uint8_t *kind;              /// node_kind per node
+  uint8_t *flags;             /// node_flag bits per node
+  string_pool *strings;       /// pool holding the long strings, nullptr if none
+  const string_pool::entry **pooled;    /// entries held in strings, released by the destructor
+  uint32_t pooled_count;
+
+  /**
+   * @brief release the pooled strings and the block, leaving an empty document.
+   * @returns void
+   */
+  void clear();
+
+  /**
+   * @brief find the atom of a name.
+   * @param name name to look up
+   * @returns atom, npos if no node uses the name
+   */
+  uint32_t find_atom(const std::string &name) const;
+
+  /**
+   * @brief serialize a node the way dom_element::innerHTML does.
+   * @param node node to write
+   * @param buffop output buffer
+   * @returns void
+   */
+  void construct_innerHTML(const node_id node, std::string &buffop) const;
+
+  /**
+   * @brief copy a string into the character pool.
+   * @param s string to copy
+   * @param pool cursor in the character pool, advanced past the copy
+   * @returns view of the copy
+   */
+  static text_ref store(const std::string &s, char *&pool);
+
+  /**
+   * @brief keep a string: interned in the string pool when it accepts it,
+   * else copied into the character pool.
+   * @param s string to keep
+   * @param pool cursor in the character pool, advanced past a copy
+   * @returns view of the kept string
+   */
+  text_ref keep(const std::string &s, char *&pool);
+
+  /**
+   * @brief check whether a node has a class atom.
+   * @param node node to check
+   * @param atom class atom
+   * @returns true if the class exists
+   */
+  inline bool has_class_atom(const node_id node, const uint32_t atom) const {
+    for (uint32_t i = class_begin[node]; i < class_begin[node + 1]; ++i) {
+      if (class_atom[i] == atom) return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief class query over the document-order range [begin, end) of the
+   * subtree of a node, the part of the range inside a match being skipped.
+   * @param atom class atom
+   * @param node node the query searches below
+   * @param begin first node of the range
+   * @param end end of the range
+   * @param dom output list
+   * @returns void
+   */
+  void class_range(const uint32_t atom, const node_id node, node_id begin, const node_id end, std::vector<node_id> &dom) const;
+
+public:
+  /**
+   * @brief freeze a document (or any subtree) into the compact form.
+   * @param root root of the tree to copy, it is not modified.
+   * @param strings pool to intern the long strings in, shared by any number of
+   *                documents and threads; it must outlive the document.
+   */
+  explicit frozen_document(const dom_element *root, string_pool *strings = nullptr);
+
+  frozen_document(frozen_document &&other);
+  frozen_document &operator=(frozen_document &&other);
+  frozen_document(const frozen_document &) = delete;
+  frozen_document &operator=(const frozen_document &) = delete;
+
+  /**
+   * @brief root of the frozen tree.
+   * @returns node id of the root
+   */
+  inline node_id root() const { return 0; }
+
+  /**
+   * @brief number of nodes, text and comment nodes included.
+   * @returns node count
+   */
+  inline uint32_t size() const { return nodes; }
+
+  /**
+   * @brief bytes held by the document, the strings shared in a pool excluded.
+   * @returns size of the single allocation
+   */
+  inline size_t memory_bytes() const { return block_size; }
+
+  /**
+   * @brief number of strings of the document held in a string pool.
+   * @returns pooled string count
+   */
+  inline uint32_t pooled_strings() const { return pooled_count; }
+
+  inline node_id get_parent(const node_id node) const { return parent[node]; }
+  inline node_id get_first_child(const node_id node) const { return first_child[node]; }
+  inline node_id get_next_sibling(const node_id node) const { return next_sibling[node]; }
+  inline node_id get_subtree_end(const node_id node) const { return subtree_end[node]; }
+  /// node ids are pre-order positions: ancestry and document order are comparisons.
+  inline bool contains(const node_id node, const node_id other) const { return node <= other && other < subtree_end[node]; }
+  inline bool is_a_text_node(const node_id node) const { return kind[node] == kind_text; }
+  inline bool is_a_comment(const node_id node) const { return kind[node] == kind_comment; }
+
+  /**
+   * @brief tag name of a node.
+   * @param node node to read
+   * @returns view of the tag name, empty for text nodes and the document
+   */
+  inline text_ref tag_name(const node_id node) const {
+    return tag_atom[node] == npos ? text_ref{ "", 0 } : atom_name[tag_atom[node]];
+  }
+
+  /**
+   * @brief text of a text or comment node.
+   * @param node node to read
+   * @returns view of the text, empty for elements
+   */
+  inline text_ref text(const node_id node) const { return node_text[node]; }
+
+  /**
+   * @brief check whether a node has a class.
+   * @param node node to check
+   * @param classname name of class to check
+   * @returns true if the class exists
+   */
+  bool has_classname(const node_id node, const std::string &classname) const;
+
+  /**
+   * @brief Get attribute value of a node.
+   * @param node node to read
+   * @param attribute_name the name of attribute.
+   * @returns attribute value, empty if the attribute does not exist.
+   */
+  std::string get_attribute_value(const node_id node, const std::string &attribute_name) const;
+
+  /**
+   * @brief Get element by id
+   * @param id Element id
+   * @returns the first element in document order with this id, npos if none.
+   */
+  node_id get_element_by_id(const std::string &id) const;
+
+  /**
+   * @brief get the elements below a node having a tag name
+   * @param tagname name of tag
+   * @param node node to search below, the root by default
+   * @returns matching nodes in document order
+   */
+  std::vector<node_id> get_elements_by_tag_name(const std::string &tagname, const node_id node = 0) const;
+
+  /**
+   * @brief get_elements_by_tag_name evaluated under an execution policy: with a
+   * parallel policy, the document-order range below node is cut into equal
+   * pieces scanned on the pool, results are merged in document order.
+   * @param tagname name of tag
+   * @param policy sequential_execution or parallel_execution(pool)
+   * @param node node to search below, the root by default
+   * @returns matching nodes in document order
+   */
+  std::vector<node_id> get_elements_by_tag_name(const std::string &tagname, const execution_policy &policy,
+    const node_id node = 0) const;
+
+  /**
+   * @brief get the elements below a node having a class name; like
+   * dom_element::get_elements_by_class_name, the subtree of a match is not searched.
+   * @param classname name of class to retrieve
+   * @param node node to search below, the root by default
+   * @returns matching nodes in document order
+   */
+  std::vector<node_id> get_elements_by_class_name(const std::string &classname, const node_id node = 0) const;
+
+  /**
+   * @brief get_elements_by_class_name evaluated under an execution policy.
+   * @param classname name of class to retrieve
+   * @param policy sequential_execution or parallel_execution(pool)
+   * @param node node to search below, the root by default
+   * @returns matching nodes in document order
+   */
+  std::vector<node_id> get_elements_by_class_name(const std::string &classname, const execution_policy &policy,
+    const node_id node = 0) const;
+
+  /**
+   * @brief returns the inner text
+   * @param node node to read
+   * @returns concatenated text of the text nodes below node
+   */
+  std::string innerText(const node_id node = 0) const;
+
+  /**
+   * @brief serialize a node
+   * @param node node to serialize
+   * @returns the innerHTML of the node, same output as dom_element::innerHTML
+   */
+  std::string innerHTML(const node_id node = 0) const;
+
+  ~frozen_document();
+};
+
+#endif
@@ -1,32 +1,137 @@
 #ifndef  __HTML_PARSER_HPP_H_
 #define  __HTML_PARSER_HPP_H_
 
+#include <memory>
 #include "dom_element.hpp"
+#include "parse_filter.hpp"
+#include "parse_limits.hpp"
+#include "parse_policy.hpp"
 #include "reader.hpp"
+#include "subtree_hashes.hpp"
 
-// Minor changes, baba yaga!
-class html_parser {
-  char read;                                            /// read char
-  dom_element *document;                                /// DOM element to return
+/**
+ * @brief what the parser does with text nodes holding only whitespace, such
+ * as the indentation between block elements. Text inside pre, textarea and
+ * the other raw text elements is always kept as is.
+ */
+enum class whitespace_mode : uint8_t {
+  keep,       /// build them as they are
+  collapse,   /// build them as a single space
+  drop,       /// collapse those in inline runs, do not build those between block boundaries
+};
+
+/**
+ * @brief tag tables shared by every instantiation of basic_html_parser.
+ */
+class html_parser_tables {
+protected:
   static const std::unordered_set<std::string> st;      /// shared st instance
   static const std::unordered_set<std::string> p_text_tag;    /// shared pure text tags instance
   static const std::unordered_set<std::string> inline_elem;   /// shared inline elem instance
-  uint32_t line_number;
-  uint32_t character_in_a_line;
-  uint32_t total_character;
+
+  friend std::unordered_set<std::string> _build_st(const std::vector<std::string> &op);
+};
+
+/**
+ * @brief The recursive parser, specialized at compile time by a policy
+ * (see parse_policy.hpp): the features the policy turns off produce no code
+ * in the parsing loops. html_parser is the full DOM parser; the presets are
+ * explicitly instantiated in html_parser.cpp.
+ */
+// Minor changes, baba yaga!
+template <typename parse_policy>
+class basic_html_parser: public html_parser_tables {
+  char read;                                            /// read char
+  dom_element *document;                                /// DOM element to return
+  uint64_t line_number;
+  uint64_t character_in_a_line;
+  uint64_t total_character;
   bool head_dom_hit;
   bool body_dom_hit;
   reader <FILE *>*rd;
-  
+  const parse_filter *filter;                           /// active filter, nullptr builds everything
+  uint32_t keep_depth;                                  /// number of open subtrees kept as a whole
+  std::vector<dom_element *> spare_nodes;               /// dropped nodes kept for reuse
+  uint32_t next_order;                                  /// pre-order position of the next node, see dom_element::contains
+  dom_element *numbering_root;                          /// root of the document being built
+  std::string tag_scratch;                              /// scratch space for closing tag names
+  std::string key_scratch;                              /// scratch space for attribute keys
+  std::string value_scratch;                            /// scratch space for attribute values not stored
+  std::string text_scratch;                             /// scratch space for raw text not stored
+  std::string editable_source;                          /// source of an editable document
+  bool editable;                                        /// document can be updated with apply_edit
+  bool reparsing;                                       /// reading the content of an edited element
+  bool reparse_escaped;                                 /// the reparse read a head or body tag
+  dom_element *head_element;                            /// element flagged is_head
+  dom_element *body_element;                            /// element flagged is_body
+  const parse_limits *limits;                           /// active limits, nullptr for none
+  parse_status stop_reason;                             /// why the last parse stopped
+  bool halted;                                          /// a limit was hit: the input reads as ended
+  uint64_t next_check;                                  /// total_character at which the limits are checked next
+  uint64_t byte_budget;                                 /// limits, UINT64_MAX (UINT32_MAX) when unlimited
+  uint64_t node_budget;
+  uint64_t text_budget;
+  uint32_t depth_budget;
+  uint32_t attribute_budget;
+  uint64_t nodes_built;                                 /// nodes created by this parse
+  uint32_t depth;                                       /// elements open around the current one
+  whitespace_mode whitespace;                           /// handling of whitespace-only text nodes
+  uint32_t preserve_depth;                              /// number of open pre elements
+  std::unique_ptr<subtree_hashes> hashes;               /// hashes of the document, see set_subtree_hashing
+
+  /**
+   * @brief check the byte limit and the deadline, called by read_char every
+   * clock_interval bytes when limits are active.
+   * @returns false if the parse has to stop
+   */
+  bool within_limits();
+
+  /**
+   * @brief stop the parse: from now on the input reads as ended.
+   * @param reason limit that was hit
+   * @returns void
+   */
+  void halt(const parse_status reason);
+
+  /**
+   * @brief record that the input ended inside a construct.
+   * @param err_message what was being read
+   * @returns void
+   */
+  void input_ended(const std::string &err_message);
+
+  /**
+   * @brief check a text being read against max_text_length.
+   * @param text text read so far
+   * @returns true if it can grow, false once the parse is stopped
+   */
+  inline bool text_fits(const std::string &text) {
+    if (text.size() < text_budget) return true;
+    halt(parse_status::text_limit);
+    return false;
+  }
+
+  /**
+   * @brief set the budgets of the next parse.
+   * @param limits limits to apply, nullptr for none
+   * @returns void
+   */
+  void set_limits(const parse_limits *limits);
+
   /**
    * @brief read character, but more:
    * @returns character from file.
    */
   inline char read_char() {
+    if (total_character >= next_check && !within_limits()) {
+      return EOF;
+    }
     char c = rd->read_next_char();
     ++total_character;
-    line_number += (c == '\n');
-    character_in_a_line = ((c == '\n') ? 0 : character_in_a_line + 1);
+    if constexpr (parse_policy::track_positions) {
+      line_number += (c == '\n');
+      character_in_a_line = ((c == '\n') ? 0 : character_in_a_line + 1);
+    }
     return c;
   }
 
@@ -86,6 +191,94 @@ class html_parser {
     }
   }
 
+  /**
+   * @brief give a new node the next pre-order position. The subtree end
+   * is set when its element is closed, leaves keep this one.
+   * @param dom new node
+   * @returns void
+   */
+  inline void number_node(dom_element *dom) {
+    dom->order_begin = next_order++;
+    dom->order_end = next_order;
+    dom->order_root = numbering_root;
+  }
+
+  /**
+   * @brief get a node, reusing a dropped one if available.
+   * @param parent parent of the new node
+   * @returns fresh DOM element, nullptr once max_nodes were built: the parse
+   * is then halted and unwinds from there
+   */
+  inline dom_element *create_node(dom_element *parent) {
+    if (nodes_built == node_budget) {
+      halt(parse_status::node_limit);
+      return nullptr;
+    }
+    ++nodes_built;
+    if (spare_nodes.empty()) {
+      dom_element *dom = new dom_element(parent);
+      number_node(dom);
+      return dom;
+    }
+    dom_element *dom = spare_nodes.back();
+    spare_nodes.pop_back();
+    dom->reset(parent);
+    number_node(dom);
+    return dom;
+  }
+
+  /**
+   * @brief hand a node and all its child nodes back for reuse.
+   * @param dom node to drop, must already be detached from its parent.
+   * @returns void
+   */
+  void recycle_node(dom_element *dom);
+
+  /**
+   * @brief check whether whitespace-only text next to the last child node of
+   * an element is part of an inline run.
+   * @param dom element whose last child node is the text
+   * @returns true if the previous sibling (comments skipped) is text or an
+   *          inline element, or if there is none and dom is inline
+   */
+  bool follows_inline(const dom_element *dom) const;
+
+  /**
+   * @brief remove a whitespace-only text node from its parent and reuse it.
+   * The node before it, or else the one after it, is flagged with space_after
+   * or space_before instead. A node with no sibling is kept.
+   * @param dom parent
+   * @param text text node among the last child nodes of dom
+   * @returns void
+   */
+  void drop_blank(dom_element *dom, dom_element *text);
+
+  /**
+   * @brief check if a text run at this point has to be stored.
+   * @param keep_text whether the enclosing element keeps its text
+   * @returns true if text node should be built
+   */
+  inline bool text_is_kept(const bool keep_text) const {
+    return parse_policy::build_text && (!filter || keep_depth || keep_text);
+  }
+
+  /**
+   * @brief check if a comment at this point has to be stored: comments
+   * follow the text of the enclosing element.
+   * @param keep_text whether the enclosing element keeps its text
+   * @returns true if comment node should be built
+   */
+  inline bool comment_is_kept(const bool keep_text) const {
+    return parse_policy::build_comments && (!filter || keep_depth || keep_text);
+  }
+
+  /**
+   * @brief open a file and load it into the reader.
+   * @param path path to an HTML file.
+   * @returns void
+   */
+  void load_file(const char *path);
+
   /**
    * @brief read the entire file
    * @returns void
@@ -104,9 +297,10 @@ class html_parser {
   /**
    * @brief read attributes of a tag.
    * @param dom DOM pointer to store attributes
+   * @param store false to scan past them without storing them
    * @returns void
    */
-  void read_attributes(dom_element *dom);
+  void read_attributes(dom_element *dom, const bool store = true);
 
   /**
    * @brief constructs classlist for the DOM element
@@ -121,42 +315,79 @@ class html_parser {
    * @param parent_dom the parent DOM that contains this element.
    * @param was_prev_read the character that read previously by parent dom but needs 
    *                      to be included in this DOM
-   * @returns element
+   * @param keep_comment whether a comment read here is stored, see comment_is_kept
+   * @returns element, or nullptr if the element was dropped by the filter.
    */
-  dom_element* read_tags(dom_element *parent_dom, const char was_prev_read = '\0');
+  dom_element* read_tags(dom_element *parent_dom, const char was_prev_read, const bool keep_comment);
 
   /**
    * @brief reads inner html of the tag.
    * @param dom parent dom of the innerhtml which will be parsed.
+   * @param keep_text whether the text directly inside dom is stored.
    * @returns void
    */
-  void read_innerhtml(dom_element *dom);
+  void read_innerhtml(dom_element *dom, const bool keep_text = true);
 
   /**
    * @brief Parsing specifically for javascript.
    * @param dom parent dom of the innertext which will be parsed.
+   * @param build false to scan the text without building a text node
    * @returns void
    */
-  void javascript_parser(dom_element *dom);
+  void javascript_parser(dom_element *dom, const bool build);
 
   /**
    * @brief parsing tags that does not contain any tags.
    * @param dom parent dom of the innertext which will be parsed.
+   * @param build false to scan the text without building a text node
    * @returns void
    */
-  void pure_text_tag_parser(dom_element *dom);
+  void pure_text_tag_parser(dom_element *dom, const bool build);
+
+  /**
+   * @brief parse editable_source from scratch.
+   * @returns the document
+   */
+  dom_element *parse_editable_source();
+
+  /**
+   * @brief find the innermost element covering a byte range of the source
+   * that can be reparsed on its own.
+   * @param offset start of the range
+   * @param removed length of the range
+   * @param begin set to the offset of the element
+   * @param path set to the element and its ancestors, with the index of
+   *             each one in the children of its parent
+   * @param whole set when the edit touches the start tag: the element is
+   *              reparsed as a whole instead of its content
+   * @returns element, nullptr if there is none
+   */
+  dom_element *find_edit_target(const uint64_t offset, const uint64_t removed, uint64_t &begin,
+    std::vector<std::pair<dom_element *, size_t>> &path, bool &whole) const;
+
+  /**
+   * @brief check whether an element holds the head or body element.
+   * @param dom element to check
+   * @returns true if dom is an ancestor of either
+   */
+  bool holds_head_or_body(const dom_element *dom) const;
 
 public:
   /**
    * @brief default constructor;
    */
-  html_parser(): document(nullptr), rd(nullptr) {}
+  basic_html_parser(): document(nullptr), rd(nullptr), filter(nullptr), keep_depth(0), next_order(0),
+    numbering_root(nullptr), editable(false),
+    reparsing(false), reparse_escaped(false), head_element(nullptr), body_element(nullptr),
+    whitespace(whitespace_mode::keep), preserve_depth(0) {
+    set_limits(nullptr);
+  }
 
   /**
    * @brief Initialize DOM via file.
    * @param path path to an HTML file.
    */
-  html_parser(const char *path);
+  basic_html_parser(const char *path);
 
   /**
    * @brief returns the main DOM element
@@ -167,14 +398,189 @@ public:
   }
 
   /**
-   * @brief Return the parsed file
+   * @brief Drop the current document so that the parser can be reused.
+   * Its nodes, the input buffer and the scratch strings keep their memory
+   * for the next parse, so parsing similar-sized pages with one long-lived
+   * parser allocates very little. Pointers into the old document become invalid.
+   * @returns void
+   */
+  void reset();
+
+  /**
+   * @brief Return the parsed file. The previous document of this parser is
+   * reset (see reset()) and its memory is reused.
    * @param path path to an HTML file.
    * @returns a dom_element from a file
    */
   dom_element *parse_html(const char *path);
 
-  friend std::unordered_set<std::string> _build_st(const std::vector<std::string> &op);
+  /**
+   * @brief Parse a file, building only the elements selected by filter.
+   * @param path path to an HTML file.
+   * @param filter elements to keep, see parse_filter.
+   * @returns a dom_element holding the kept elements and their ancestors.
+   */
+  dom_element *parse_html(const char *path, const parse_filter &filter);
+
+  /**
+   * @brief Parse a file within a resource budget. When a limit is hit the
+   * parse stops cleanly: the document holds what was read so far, and
+   * status() tells which limit stopped it.
+   * @param path path to an HTML file.
+   * @param limits budgets of this parse, see parse_limits.
+   * @returns a dom_element holding the document read so far.
+   */
+  dom_element *parse_html(const char *path, const parse_limits &limits);
+
+  /**
+   * @brief Parse a document held in memory, such as a network response.
+   * The previous document of this parser is reset, as by parse_html.
+   * @param data first byte of the input.
+   * @param length number of bytes.
+   * @param borrow read data in place instead of copying it. data must then be
+   *               UTF-8, as it is not converted, and stay valid until this
+   *               returns. Either way the document does not point into data.
+   * @returns a dom_element from the input
+   */
+  dom_element *parse(const char *data, const size_t length, const bool borrow = false);
+
+  /**
+   * @brief Parse a document held in memory within a resource budget, as
+   * parse_html(path, limits) does.
+   * @param data first byte of the input.
+   * @param length number of bytes.
+   * @param limits budgets of this parse, see parse_limits.
+   * @param borrow read data in place, see parse(data, length, borrow).
+   * @returns a dom_element holding the document read so far.
+   */
+  dom_element *parse(const char *data, const size_t length, const parse_limits &limits, const bool borrow = false);
+
+  /**
+   * @brief choose what the following parses do with whitespace-only text
+   * nodes. Dropping them can remove a large share of the nodes of an indented
+   * page. A dropped run is remembered by a flag on a neighbouring node and
+   * serialized as one space, so innerText and innerHTML read as with
+   * whitespace_mode::collapse. The tokenized parse ignores this setting.
+   * @param mode see whitespace_mode, keep by default
+   * @returns void
+   */
+  inline void set_whitespace_mode(const whitespace_mode mode) { whitespace = mode; }
+
+  /**
+   * @brief what the parses do with whitespace-only text nodes.
+   * @returns mode set by set_whitespace_mode
+   */
+  inline whitespace_mode get_whitespace_mode() const { return whitespace; }
+
+  /**
+   * @brief keep a subtree_hashes table of the document: every node is hashed
+   * at the end of the following parses, and the path to the root after each
+   * apply_edit. Off by default, so that nodes cost nothing for hashing.
+   * @param enabled true to create the table, false to free it
+   * @returns void
+   */
+  inline void set_subtree_hashing(const bool enabled) {
+    if (!enabled) {
+      hashes.reset();
+      return;
+    }
+    if (!hashes) hashes.reset(new subtree_hashes());
+    if (document) hashes->hash(document);
+  }
+
+  /**
+   * @brief hashes of the document, for equals, diff and boilerplate.
+   * @returns table kept by set_subtree_hashing, nullptr if off
+   */
+  inline subtree_hashes *get_subtree_hashes() const { return hashes.get(); }
+
+  /**
+   * @brief why the last parse by parse_html or parse stopped. Not set by
+   * parse_html_tokenized, after which it is always parse_status::complete.
+   * @returns parse_status::complete if it read the whole input
+   */
+  inline parse_status status() const { return stop_reason; }
+
+  /**
+   * @brief Parse a file with html_tokenizer feeding html_tree_builder instead
+   * of the recursive parser.
+   * This path applies no parse_limits, no parse_filter and no whitespace_mode,
+   * whatever the other parses were given, and does not set status(): the
+   * whole input is always read and built. Use parse_html(path, limits) for
+   * input that needs a budget.
+   * @param path path to an HTML file.
+   * @param pipelined run the tokenizer on its own thread, handing the tokens
+   *                  to the tree builder through a lock-free queue.
+   * @returns a dom_element from a file
+   */
+  dom_element *parse_html_tokenized(const char *path, const bool pipelined = false);
+
+  /**
+   * @brief Parse a file and keep its source (converted to UTF-8), so that the
+   * document can then be updated with apply_edit.
+   * @param path path to an HTML file.
+   * @returns a dom_element from a file
+   */
+  dom_element *parse_html_editable(const char *path);
+
+  /**
+   * @brief Parse a document held in a string, kept for apply_edit.
+   * @param source UTF-8 HTML source.
+   * @returns a dom_element from the source
+   */
+  dom_element *parse_html_editable(const std::string &source);
+
+  /**
+   * @brief Apply an edit to the source of an editable document and update the
+   * document. Only the content of the innermost element enclosing the edit is
+   * reparsed and spliced in; when the reparse does not end where that
+   * element ended (an edit opening a comment or closing the element, for
+   * instance) the whole source is reparsed instead.
+   * Pointers into the reparsed element's old content become invalid, and after
+   * a full reparse all pointers into the document do. The document order
+   * positions (dom_element::contains) are given again to the whole tree.
+   * @param offset where the edit starts in the current source
+   * @param removed number of bytes removed at offset
+   * @param inserted bytes inserted at offset
+   * @returns the element whose content was reparsed, the document after a full
+   *          reparse, nullptr if the document is not editable or the edit is out of range.
+   */
+  dom_element *apply_edit(const uint64_t offset, const uint64_t removed, const std::string &inserted);
+
+  /**
+   * @brief source of the editable document, edits included.
+   * @returns UTF-8 source
+   */
+  inline const std::string &source() const { return editable_source; }
+
+  /**
+   * @brief memory held by the current document, the reader buffers and the
+   * nodes kept for reuse.
+   * @returns report by category
+   */
+  memory_usage memory_report() const;
+
+  /**
+   * @brief destructor for html_parser, frees the current document as well.
+   */
+  ~basic_html_parser();
+
+  friend class dom_element;
+  friend class html_tokenizer;
+  friend class html_tree_builder;
+  friend class link_extractor;
 
 };
 
+extern template class basic_html_parser<full_dom_policy>;
+extern template class basic_html_parser<extraction_policy>;
+extern template class basic_html_parser<validation_policy>;
+
+/// parser building the whole DOM
+typedef basic_html_parser<full_dom_policy> html_parser;
+/// parser for text and attribute extraction, see extraction_policy
+typedef basic_html_parser<extraction_policy> extraction_parser;
+/// parser checking the structure only, see validation_policy
+typedef basic_html_parser<validation_policy> validation_parser;
+
 #endif
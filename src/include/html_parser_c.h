@@ -0,0 +1,247 @@
+#ifndef __HTML_PARSER_C_H_
+#define __HTML_PARSER_C_H_
+
+/*
+ * C interface of libhtml_parser, for programs that link the parser in
+ * process. Handles are opaque and every function is exported with C
+ * linkage, so the interface does not depend on the C++ standard library
+ * the library was built with.
+ *
+ * Strings returned as `const char *` point into the document: they are
+ * NUL-terminated, and stay valid until the document is parsed again or
+ * destroyed. Strings returned as `char *` are allocated for the caller,
+ * who releases them with hp_string_free.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define HP_EXPORT __declspec(dllexport)
+#else
+#define HP_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** version of this interface, raised on incompatible changes. */
+#define HP_ABI_VERSION 1
+
+/** hp_parse flag: read the input in place instead of copying it, see hp_parse. */
+#define HP_PARSE_BORROW 1u
+/** hp_parse flag: build whitespace-only text nodes as one space, see whitespace_mode. */
+#define HP_PARSE_COLLAPSE_WHITESPACE 2u
+/** hp_parse flag: drop whitespace-only text nodes between block boundaries, see whitespace_mode. */
+#define HP_PARSE_DROP_WHITESPACE 4u
+
+/** a parsed document, with the parser that built it. */
+typedef struct hp_document hp_document;
+
+/** an element, text node or comment of a document. */
+typedef struct hp_node hp_node;
+
+/** why a parse stopped, the values of parse_status, plus HP_STATUS_FAILED. */
+typedef enum hp_status {
+  HP_STATUS_COMPLETE = 0,
+  HP_STATUS_UNEXPECTED_END = 1,
+  HP_STATUS_BYTE_LIMIT = 2,
+  HP_STATUS_NODE_LIMIT = 3,
+  HP_STATUS_DEPTH_LIMIT = 4,
+  HP_STATUS_ATTRIBUTE_LIMIT = 5,
+  HP_STATUS_TEXT_LIMIT = 6,
+  HP_STATUS_DEADLINE = 7,
+  HP_STATUS_FAILED = 8        /* the last hp_parse failed and returned NULL */
+} hp_status;
+
+/** resource budget of a parse, see parse_limits. 0 means no limit. */
+typedef struct hp_limits {
+  uint64_t max_bytes;
+  uint64_t max_nodes;
+  uint32_t max_depth;
+  uint32_t max_attributes;
+  uint64_t max_text_length;
+  uint64_t timeout_us;        /* time the parse may take, in microseconds */
+} hp_limits;
+
+/**
+ * @brief version of the interface implemented by the loaded library.
+ * @returns HP_ABI_VERSION of the library
+ */
+HP_EXPORT uint32_t hp_abi_version(void);
+
+/**
+ * @brief create an empty document, to be filled by hp_parse.
+ * @returns document, NULL if out of memory
+ */
+HP_EXPORT hp_document *hp_document_create(void);
+
+/**
+ * @brief destroy a document and every node of it.
+ * @param document document, may be NULL
+ */
+HP_EXPORT void hp_document_destroy(hp_document *document);
+
+/**
+ * @brief parse an input held in memory into a document, replacing its
+ * previous content. The memory of the previous parse is reused, so one
+ * document per thread can parse any number of inputs.
+ * @param document document to fill
+ * @param data first byte of the input
+ * @param length number of bytes
+ * @param flags HP_PARSE_BORROW to read data in place: it must then be UTF-8
+ *              and stay valid until this returns. HP_PARSE_COLLAPSE_WHITESPACE
+ *              or HP_PARSE_DROP_WHITESPACE to elide whitespace-only text.
+ * @param limits budget of the parse, NULL for none
+ * @returns root node of the document, NULL on failure
+ */
+HP_EXPORT const hp_node *hp_parse(hp_document *document, const char *data, size_t length, uint32_t flags,
+  const hp_limits *limits);
+
+/**
+ * @brief why the last parse of a document stopped.
+ * @param document document
+ * @returns HP_STATUS_COMPLETE if the whole input was read, HP_STATUS_FAILED
+ *          if hp_parse returned NULL (out of memory)
+ */
+HP_EXPORT hp_status hp_document_status(const hp_document *document);
+
+/**
+ * @brief root node of a document, holding the top level nodes.
+ * @param document document
+ * @returns root node, NULL before the first parse
+ */
+HP_EXPORT const hp_node *hp_document_root(const hp_document *document);
+
+/**
+ * @brief tag name of an element.
+ * @param node node
+ * @returns lowercase tag name, empty for text nodes and comments
+ */
+HP_EXPORT const char *hp_node_tag(const hp_node *node);
+
+/**
+ * @brief check if a node is a text node.
+ * @param node node
+ * @returns 1 for a text node, else 0
+ */
+HP_EXPORT int hp_node_is_text(const hp_node *node);
+
+/**
+ * @brief check if a node is a comment (or a doctype).
+ * @param node node
+ * @returns 1 for a comment, else 0
+ */
+HP_EXPORT int hp_node_is_comment(const hp_node *node);
+
+/**
+ * @brief own text of a text node or comment.
+ * @param node node
+ * @param length set to the length of the text, may be NULL
+ * @returns NUL-terminated text, never NULL, empty for elements
+ */
+HP_EXPORT const char *hp_node_text(const hp_node *node, size_t *length);
+
+/**
+ * @brief value of an attribute of an element.
+ * @param node element
+ * @param name attribute name
+ * @param length set to the length of the value, may be NULL
+ * @returns value, NULL if the element has no such attribute or out of memory
+ */
+HP_EXPORT const char *hp_node_attribute(const hp_node *node, const char *name, size_t *length);
+
+/**
+ * @brief parent of a node.
+ * @param node node
+ * @returns parent, NULL for the root
+ */
+HP_EXPORT const hp_node *hp_node_parent(const hp_node *node);
+
+/**
+ * @brief number of child nodes, text nodes and comments included.
+ * @param node node
+ * @returns number of child nodes
+ */
+HP_EXPORT size_t hp_node_child_count(const hp_node *node);
+
+/**
+ * @brief child node by position.
+ * @param node node
+ * @param index position among the child nodes
+ * @returns child, NULL if index is out of range
+ */
+HP_EXPORT const hp_node *hp_node_child(const hp_node *node, size_t index);
+
+/**
+ * @brief text of the text nodes below a node.
+ * @param node node
+ * @returns allocated string, to free with hp_string_free, NULL if out of memory
+ */
+HP_EXPORT char *hp_node_inner_text(const hp_node *node);
+
+/**
+ * @brief serialize a node.
+ * @param node node
+ * @param minified 1 for the minified form, see dom_element::minified_innerHTML
+ * @returns allocated string, to free with hp_string_free, NULL if out of memory
+ */
+HP_EXPORT char *hp_node_inner_html(const hp_node *node, int minified);
+
+/**
+ * @brief free a string returned by this interface.
+ * @param s string, may be NULL
+ */
+HP_EXPORT void hp_string_free(char *s);
+
+/**
+ * @brief find the element having an id, below a node.
+ * @param node node to search below
+ * @param id element id
+ * @returns element, NULL if none
+ */
+HP_EXPORT const hp_node *hp_get_element_by_id(const hp_node *node, const char *id);
+
+/**
+ * @brief find the elements having a tag name, below a node. The number of
+ * matches is returned even when out is too small, so a caller can size out
+ * with a first call passing capacity 0.
+ * @param node node to search below
+ * @param tag tag name
+ * @param out receives up to capacity elements, in document order, may be NULL if capacity is 0
+ * @param capacity size of out
+ * @returns number of matching elements, (size_t)-1 if out of memory
+ */
+HP_EXPORT size_t hp_get_elements_by_tag_name(const hp_node *node, const char *tag, const hp_node **out,
+  size_t capacity);
+
+/**
+ * @brief find the elements having a class name, below a node, as
+ * dom_element::get_elements_by_class_name does. Output as in
+ * hp_get_elements_by_tag_name.
+ * @param node node to search below
+ * @param class_name class name
+ * @param out receives up to capacity elements, may be NULL if capacity is 0
+ * @param capacity size of out
+ * @returns number of matching elements, (size_t)-1 if out of memory
+ */
+HP_EXPORT size_t hp_get_elements_by_class_name(const hp_node *node, const char *class_name, const hp_node **out,
+  size_t capacity);
+
+/**
+ * @brief select nodes with an XPath expression of the subset xpath supports.
+ * Output as in hp_get_elements_by_tag_name.
+ * @param node context node
+ * @param expression XPath expression
+ * @param out receives up to capacity nodes, may be NULL if capacity is 0
+ * @param capacity size of out
+ * @returns number of selected nodes, (size_t)-1 if the expression does not compile
+ */
+HP_EXPORT size_t hp_select(const hp_node *node, const char *expression, const hp_node **out, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
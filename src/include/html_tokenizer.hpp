@@ -0,0 +1,112 @@
+#ifndef __HTML_TOKENIZER_HPP_H_
+#define __HTML_TOKENIZER_HPP_H_
+
+#include <string>
+#include "reader.hpp"
+
+/**
+ * @brief kind of token produced by html_tokenizer.
+ * An element start is emitted as start_tag, then one attribute token per
+ * attribute, then start_tag_close.
+ */
+enum class token_type : uint8_t {
+  start_tag,          /// name holds the lowercase tag name
+  attribute,          /// name holds the lowercase key, value the raw value
+  start_tag_close,    /// '>' or '/>' of a start tag, see self_closing
+  end_tag,            /// name holds the lowercase tag name
+  text,               /// value holds the text
+  comment,            /// value holds the comment body (also doctype)
+  raw_text,           /// value holds the body of script/style/title/textarea
+  end_of_file         /// no more tokens
+};
+
+/**
+ * @brief a token; the strings are reused between tokens, so a token slot
+ * stops allocating once it has seen the longest text it will hold.
+ */
+struct html_token {
+  token_type type;
+  bool self_closing;   /// start_tag_close: the tag ended with "/>"
+  uint64_t begin;      /// offset of the first character of the token
+  uint64_t end;        /// offset past the last character of the token
+  std::string name;    /// tag or attribute name
+  std::string value;   /// attribute value, text, comment or raw text
+};
+
+/**
+ * @brief Splits an input into html_tokens without building any tree.
+ * Tokens are pulled one at a time with next().
+ */
+class html_tokenizer {
+  enum class state : uint8_t { data, in_tag, raw, raw_end };
+  reader <FILE *>*rd;
+  char read;                /// current character
+  uint64_t position;        /// offset of the current character
+  state st;                 /// where the next token starts
+  std::string raw_tag;      /// tag closing the current raw text section
+  uint64_t raw_end_begin;   /// offset of the "</tag" that ended the raw text
+
+  /**
+   * @brief advance to the next character.
+   * @returns the new current character.
+   */
+  inline char read_char() {
+    ++position;
+    return read = rd->read_next_char();
+  }
+
+  inline bool is_a_whitespace(const char c) const { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f'; }
+  inline bool is_alpha(const char c) const { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+  inline char char_to_lowercase(const char c) const { return is_alpha(c) ? (c | 32) : c; }
+  inline bool is_name_char(const char c) const {
+    return c != EOF && !is_a_whitespace(c) && c != '>' && c != '/' && c != '=';
+  }
+
+  inline void skip_whitespaces() {
+    while (read != EOF && is_a_whitespace(read)) read_char();
+  }
+
+  /**
+   * @brief read text up to the next '<' into token.value.
+   * @param token token to fill
+   * @returns void
+   */
+  void read_text(html_token &token);
+
+  /**
+   * @brief read a comment, '<!' has been consumed.
+   * @param token token to fill
+   * @returns void
+   */
+  void read_comment(html_token &token);
+
+  /**
+   * @brief read an attribute or the end of the start tag.
+   * @param token token to fill
+   * @returns void
+   */
+  void read_in_tag(html_token &token);
+
+  /**
+   * @brief read the body of a raw text element up to its end tag.
+   * @param token token to fill
+   * @returns void
+   */
+  void read_raw_text(html_token &token);
+
+public:
+  /**
+   * @brief constructor
+   * @param rd loaded reader to tokenize, not owned.
+   */
+  html_tokenizer(reader <FILE *>*rd);
+
+  /**
+   * @brief produce the next token.
+   * @param token token to overwrite
+   * @returns false once end_of_file has been produced.
+   */
+  bool next(html_token &token);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __HTML_TREE_BUILDER_HPP_H_
+#define __HTML_TREE_BUILDER_HPP_H_
+
+#include <vector>
+#include "dom_element.hpp"
+#include "html_tokenizer.hpp"
+
+/**
+ * @brief Builds a dom_element tree from the tokens of html_tokenizer.
+ * Tokens can come straight from the tokenizer or through a queue, the
+ * builder keeps its own stack of open elements.
+ */
+class html_tree_builder {
+  dom_element *document;                    /// root being built
+  dom_element *pending;                     /// start tag waiting for its attributes
+  std::vector<dom_element *> open_elements; /// open elements, document at the bottom
+  bool head_dom_hit;
+  bool body_dom_hit;
+
+  /**
+   * @brief split a class attribute into the class list of the element.
+   * @param dom element to update
+   * @param value space separated class names
+   * @returns void
+   */
+  void set_class(dom_element *dom, const std::string &value);
+
+public:
+  /**
+   * @brief constructor, starts an empty document.
+   */
+  html_tree_builder();
+
+  /**
+   * @brief apply one token to the tree.
+   * @param token token to apply, it is not kept.
+   * @returns void
+   */
+  void consume(const html_token &token);
+
+  /**
+   * @brief hand over the built document; the builder starts a new one.
+   * @returns root of the built document, owned by the caller.
+   */
+  dom_element *finish();
+
+  /**
+   * @brief destructor, frees a document that was not handed over.
+   */
+  ~html_tree_builder();
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __LINK_EXTRACTOR_HPP_H_
+#define __LINK_EXTRACTOR_HPP_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "reader.hpp"
+
+/**
+ * @brief DOM-free extraction of the URLs of a document: href, src, srcset
+ * and action attribute values. The input is scanned once, in place: text,
+ * comments and raw text bodies (script, style...) are skipped with memchr,
+ * tags are lexed like html_tokenizer does, and nothing is allocated per
+ * element. URLs are views into the input with their offsets, and the first
+ * <base href> is kept to resolve them.
+ */
+class link_extractor {
+public:
+  enum class link_attribute : uint8_t { href, src, srcset, action };
+
+  /// one URL found in the input
+  struct link {
+    std::string_view url;       /// value as written, a single candidate for srcset
+    uint64_t offset;            /// offset of url in the (UTF-8) input
+    std::string_view tag;       /// name of the element, as written
+    link_attribute attribute;   /// attribute holding the url
+  };
+
+private:
+  std::vector<link> links;
+  std::string_view base_url;
+  reader<FILE *> rd;            /// file input, kept for the views of the last extract_file
+  std::string stream_copy;      /// streaming sources, gathered to be scanned in place
+  std::string name_scratch;     /// lowercase tag name, to look up raw text tags
+
+  /**
+   * @brief lex the attributes of a start tag, emitting the URLs.
+   * @param begin start of the input
+   * @param p position after the tag name, advanced past the tag
+   * @param end end of the input
+   * @param tag name of the element
+   * @param is_base the element is a <base>
+   * @returns void
+   */
+  void read_attributes(const char *begin, const char *&p, const char *end, const std::string_view tag, const bool is_base);
+
+  /**
+   * @brief split a srcset value into its candidate URLs.
+   * @param begin start of the input
+   * @param value srcset value
+   * @param tag name of the element
+   * @returns void
+   */
+  void emit_srcset(const char *begin, const std::string_view value, const std::string_view tag);
+
+public:
+  link_extractor() = default;
+
+  /// owns the reader of extract_file, and the returned links view its buffer.
+  link_extractor(const link_extractor &) = delete;
+  link_extractor &operator=(const link_extractor &) = delete;
+
+  /**
+   * @brief extract the URLs of an input held in memory.
+   * @param data UTF-8 input, it must outlive the returned views.
+   * @param size length of the input
+   * @returns URLs in document order, valid until the next call
+   */
+  const std::vector<link> &extract(const char *data, const size_t size);
+
+  /**
+   * @brief extract the URLs of a file, loaded like html_parser does
+   * (decompression, conversion to UTF-8).
+   * @param path path of the file
+   * @returns URLs in document order, valid until the next call
+   */
+  const std::vector<link> &extract_file(const char *path);
+
+  /**
+   * @brief the href of the first <base> element of the last input.
+   * @returns the base URL, empty if the document has none
+   */
+  inline std::string_view base() const { return base_url; }
+
+  /**
+   * @brief resolve a URL against the base URL of the last input (RFC 3986).
+   * @param url relative or absolute URL
+   * @returns absolute URL, url itself when there is no absolute base
+   */
+  std::string resolve(const std::string_view url) const;
+};
+
+#endif
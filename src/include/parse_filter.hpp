@@ -0,0 +1,58 @@
+#ifndef __PARSE_FILTER_HPP_H_
+#define __PARSE_FILTER_HPP_H_
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include "dom_element.hpp"
+
+/**
+ * @brief Selects the part of a document that html_parser builds.
+ * An element is kept if it matches the filter, if it is an ancestor of
+ * a kept element, or if it is inside the subtree rooted at subtree_id.
+ * Everything else is scanned past and never attached to the document:
+ * the text of a rejected script or style is not stored, and when the filter
+ * only has tags, neither are the attributes of a rejected element (an
+ * ancestor kept for a match below it then has none).
+ * Text and comments directly under a matched element are kept with
+ * keep_text, and everything inside the subtree_id subtree is kept.
+ */
+struct parse_filter {
+  std::unordered_set<std::string> tags;         /// keep elements with these tag names
+  std::unordered_set<std::string> attributes;   /// keep elements having any of these attributes
+  std::string subtree_id;                       /// keep the whole subtree of the element with this id
+  /// custom condition, evaluated once the start tag and attributes are read.
+  std::function<bool(const dom_element &)> predicate;
+  bool keep_text = true;                        /// keep text nodes and comments directly under matched elements
+
+  /**
+   * @brief check whether matches() depends on the tag name only, so that it
+   * can be decided before the attributes are read.
+   * @returns true if only tags are set
+   */
+  inline bool by_tag_only() const { return attributes.empty() && !predicate && subtree_id.empty(); }
+
+  /**
+   * @brief check whether an element (with its start tag read) matches.
+   * @param dom element to check
+   * @returns true if the element should be kept.
+   */
+  inline bool matches(const dom_element &dom) const {
+    if (tags.find(dom.tag_name()) != tags.end()) return true;
+    for (auto &x: attributes) {
+      if (dom.has_attribute(x)) return true;
+    }
+    return predicate && predicate(dom);
+  }
+
+  /**
+   * @brief check whether an element starts the subtree to keep as a whole.
+   * @param dom element to check
+   * @returns true if the element id is subtree_id.
+   */
+  inline bool is_subtree_root(const dom_element &dom) const {
+    return subtree_id.size() && dom.get_id() == subtree_id;
+  }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __PARSE_LIMITS_HPP_H_
+#define __PARSE_LIMITS_HPP_H_
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief why a parse stopped.
+ */
+enum class parse_status : uint8_t {
+  complete,           /// the whole input was parsed
+  unexpected_end,     /// the input ended inside a comment, tag or raw text, which is kept as read
+  byte_limit,         /// parse_limits::max_bytes were read
+  node_limit,         /// parse_limits::max_nodes were built
+  depth_limit,        /// an element was nested deeper than parse_limits::max_depth
+  attribute_limit,    /// an element had more than parse_limits::max_attributes
+  text_limit,         /// a text, comment or attribute value exceeded parse_limits::max_text_length
+  deadline            /// parse_limits::deadline passed
+};
+
+/**
+ * @brief name of a parse status.
+ * @param status status to name
+ * @returns lowercase name, as in the enum
+ */
+inline const char *parse_status_name(const parse_status status) {
+  switch (status) {
+    case parse_status::complete: return "complete";
+    case parse_status::unexpected_end: return "unexpected_end";
+    case parse_status::byte_limit: return "byte_limit";
+    case parse_status::node_limit: return "node_limit";
+    case parse_status::depth_limit: return "depth_limit";
+    case parse_status::attribute_limit: return "attribute_limit";
+    case parse_status::text_limit: return "text_limit";
+    case parse_status::deadline: return "deadline";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Resource budget of one parse by html_parser. A parse exceeding any
+ * of them stops where it is: the input is treated as ended, the elements
+ * read so far form the document, and html_parser::status() tells why.
+ * A limit of 0 means no limit.
+ */
+struct parse_limits {
+  uint64_t max_bytes = 0;             /// input bytes read, after decompression and conversion to UTF-8
+  uint64_t max_nodes = 0;             /// nodes built, text nodes and comments included
+  uint32_t max_depth = 0;             /// nesting of elements
+  uint32_t max_attributes = 0;        /// attributes of one element
+  uint64_t max_text_length = 0;       /// bytes of one text node, comment, raw text or attribute value
+  /// the parse stops once this time has passed
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  uint32_t clock_interval = 4096;     /// bytes read between two looks at the clock
+
+  /**
+   * @brief set the deadline relative to now.
+   * @param timeout time the parse may take
+   * @returns this, for chaining
+   */
+  inline parse_limits &with_timeout(const std::chrono::steady_clock::duration timeout) {
+    deadline = std::chrono::steady_clock::now() + timeout;
+    return *this;
+  }
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __PARSE_POLICY_HPP_H_
+#define __PARSE_POLICY_HPP_H_
+
+/**
+ * @brief Compile-time features of basic_html_parser. A policy is a type with
+ * these static constexpr members; a feature turned off is compiled out of
+ * the parsing loops instead of being tested at run time.
+ * - track_positions: line and column kept by read_char, for error messages
+ * - build_comments: comments (the doctype included) become nodes
+ * - detect_head_body: the first head and body are flagged, whitespace in head is skipped
+ * - build_class_list: the class attribute is split into the class list
+ * - build_text: text nodes are built, raw text elements included
+ */
+struct full_dom_policy {
+  static constexpr bool track_positions = true;
+  static constexpr bool build_comments = true;
+  static constexpr bool detect_head_body = true;
+  static constexpr bool build_class_list = true;
+  static constexpr bool build_text = true;
+};
+
+/**
+ * @brief text, links and attribute extraction: no comments, positions or
+ * head and body flags.
+ */
+struct extraction_policy {
+  static constexpr bool track_positions = false;
+  static constexpr bool build_comments = false;
+  static constexpr bool detect_head_body = false;
+  static constexpr bool build_class_list = true;
+  static constexpr bool build_text = true;
+};
+
+/**
+ * @brief checking the structure of a document: elements and attributes
+ * only, with positions for the error messages.
+ */
+struct validation_policy {
+  static constexpr bool track_positions = true;
+  static constexpr bool build_comments = false;
+  static constexpr bool detect_head_body = false;
+  static constexpr bool build_class_list = false;
+  static constexpr bool build_text = false;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef __QUERY_BATCH_HPP_H_
+#define __QUERY_BATCH_HPP_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dom_element.hpp"
+
+/**
+ * @brief Set of independent queries evaluated together in one traversal of
+ * a tree. Queries are indexed by the key they test (tag, class, id or
+ * attribute name), so each node costs one lookup per tag, class and
+ * attribute it has instead of one check per query. Results are bucketed per
+ * query, in document order, and are the same as the matching dom_element call.
+ */
+class query_batch {
+public:
+  typedef size_t query_id;
+
+private:
+  enum class query_kind : uint8_t { tag, class_name, id, attribute };
+
+  struct query {
+    query_kind kind;
+    std::string value;       /// attribute queries: value to compare with
+    bool any_value;          /// attribute queries: match whatever the value
+  };
+
+  std::vector<query> queries;
+  std::vector<std::vector<dom_element *>> matches;     /// results, per query
+  std::vector<const dom_element *> inside;             /// class queries: match being searched below
+  /// queries indexed by the key they test
+  std::unordered_map<std::string, std::vector<query_id>> by_tag, by_class, by_id, by_attribute;
+
+  /**
+   * @brief register a query.
+   * @param index index of the query kind
+   * @param key key the query tests
+   * @param kind kind of the query
+   * @param value attribute value to compare with
+   * @param any_value match whatever the attribute value
+   * @returns id of the query
+   */
+  query_id add(std::unordered_map<std::string, std::vector<query_id>> &index, const std::string &key,
+    const query_kind kind, const std::string &value = "", const bool any_value = true);
+
+  /**
+   * @brief evaluate all queries on the elements below a node.
+   * @param node node to search below
+   * @returns void
+   */
+  void visit(const dom_element *node);
+
+public:
+  /**
+   * @brief elements having a tag name, as dom_element::get_elements_by_tag_name.
+   * @param tagname name of tag
+   * @returns id of the query
+   */
+  inline query_id add_tag(const std::string &tagname) {
+    return add(by_tag, tagname, query_kind::tag);
+  }
+
+  /**
+   * @brief elements having a class, as dom_element::get_elements_by_class_name.
+   * @param classname name of class
+   * @returns id of the query
+   */
+  inline query_id add_class(const std::string &classname) {
+    return add(by_class, classname, query_kind::class_name);
+  }
+
+  /**
+   * @brief element having an id, as dom_element::get_element_by_id: at most one result.
+   * @param id element id
+   * @returns id of the query
+   */
+  inline query_id add_id(const std::string &id) {
+    return add(by_id, id, query_kind::id);
+  }
+
+  /**
+   * @brief elements having an attribute, whatever its value.
+   * @param attribute_name the name of attribute.
+   * @returns id of the query
+   */
+  inline query_id add_attribute(const std::string &attribute_name) {
+    return add(by_attribute, attribute_name, query_kind::attribute);
+  }
+
+  /**
+   * @brief elements having an attribute with a given value.
+   * @param attribute_name the name of attribute.
+   * @param value value of the attribute
+   * @returns id of the query
+   */
+  inline query_id add_attribute(const std::string &attribute_name, const std::string &value) {
+    return add(by_attribute, attribute_name, query_kind::attribute, value, false);
+  }
+
+  /**
+   * @brief number of registered queries.
+   * @returns query count
+   */
+  inline size_t size() const { return queries.size(); }
+
+  /**
+   * @brief evaluate every query below a node, replacing the previous results.
+   * @param root node to search below, usually the document
+   * @returns void
+   */
+  void run(const dom_element *root);
+
+  /**
+   * @brief results of a query of the last run.
+   * @param query id returned when the query was added
+   * @returns matching elements in document order
+   */
+  inline const std::vector<dom_element *> &results(const query_id query) const {
+    return matches[query];
+  }
+};
+
+#endif
@@ -1,44 +1,439 @@
 #ifndef __READER_H__
 #define __READER_H__
 
+#include <cstring>
 #include <iostream>
+#include <utility>
+#include "encoding.hpp"
+#ifdef HTML_PARSER_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HTML_PARSER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+/// size of the chunks compressed or windowed input is read in
+#define READER_CHUNK_SIZE (1U << 16)
+/// files larger than this are read through a window instead of in full
+#ifndef READER_WINDOW_THRESHOLD
+#define READER_WINDOW_THRESHOLD (1ULL << 30)
+#endif
 
 template <typename __reader_type>
 class reader {
+  /// where the characters come from: the whole input in memory, a file
+  /// read through a sliding window, or a compressed file decompressed one
+  /// chunk at a time.
+  enum class source_kind : uint8_t { buffer, window, gzip, zstd };
   __reader_type typ;
   char *read_buffer;
-  uint32_t index;
-  uint32_t size;
+  uint64_t index;
+  uint64_t size;
+  uint64_t capacity;
+  source_kind source;
+  char *input_chunk;        /// compressed bytes, streaming sources only
+  char *stage_buffer;       /// input bytes waiting to be transcoded to UTF-8
+  uint64_t stage_capacity;
+  text_encoding input_encoding;
+  bool sniffed;             /// streaming: encoding of the input is known
+  bool transcoding;         /// streaming: chunks go through transcoder
+  utf8_transcoder transcoder;
+  bool borrowed;            /// read_buffer is the caller's memory, see load_memory
+  char *held_buffer;        /// own buffer, kept aside while borrowing
+  uint64_t held_capacity;
+#ifdef HTML_PARSER_WITH_ZLIB
+  z_stream zs;
+#endif
+#ifdef HTML_PARSER_WITH_ZSTD
+  ZSTD_DStream *zds;
+  ZSTD_inBuffer zin;
+#endif
+
+#define F_READING          0
+#define SOCK_READING       1
+#define F_WINDOWED_READING 2
+
+  /**
+   * @brief make sure a buffer holds at least sz bytes, its content is not kept.
+   * @param buffer buffer to grow
+   * @param cap capacity of the buffer
+   * @param sz required size
+   * @returns void
+   */
+  static inline void reserve(char *&buffer, uint64_t &cap, const uint64_t sz) {
+    if (sz > cap) {
+      delete[] buffer;
+      buffer = new char[sz];
+      cap = sz;
+    }
+  }
+
+  /**
+   * @brief detect the encoding of an input held in full in read_buffer and
+   * convert it to UTF-8. Valid UTF-8 is read in place, without a copy.
+   * @returns void
+   */
+  void ingest_buffer() {
+    size_t bom = 0;
+    bool declared = false;
+    input_encoding = sniff_encoding(read_buffer, size, bom, declared);
+    if (input_encoding == text_encoding::utf8) {
+      if (validate_utf8(read_buffer + bom, size - bom) == size - bom) {
+        index = bom;
+        return;
+      }
+      // undeclared and not UTF-8: the usual legacy encoding.
+      if (!declared) input_encoding = text_encoding::windows_1252;
+    }
+    std::swap(read_buffer, stage_buffer);
+    std::swap(capacity, stage_capacity);
+    reserve(read_buffer, capacity, utf8_transcoder::max_output(size - bom));
+    utf8_transcoder converter(input_encoding);
+    size = converter.convert(stage_buffer + bom, size - bom, read_buffer);
+  }
+
+  /**
+   * @brief give the own buffer back to read_buffer after load_memory.
+   * @returns void
+   */
+  inline void release_borrowed() {
+    if (!borrowed) return;
+    read_buffer = held_buffer;
+    capacity = held_capacity;
+    held_buffer = nullptr;
+    held_capacity = 0;
+    borrowed = false;
+  }
+
+  /**
+   * @brief set up chunked decompression of the input file.
+   * @param kind gzip or zstd
+   * @returns true if this build can decompress the input.
+   */
+  bool open_stream(const source_kind kind) {
+    if (!input_chunk) input_chunk = new char[READER_CHUNK_SIZE];
+    reserve(read_buffer, capacity, READER_CHUNK_SIZE);
+    sniffed = transcoding = false;
+    switch (kind) {
+      case source_kind::window:
+        break;
+#ifdef HTML_PARSER_WITH_ZLIB
+      case source_kind::gzip:
+        zs.zalloc = Z_NULL;
+        zs.zfree = Z_NULL;
+        zs.opaque = Z_NULL;
+        zs.next_in = Z_NULL;
+        zs.avail_in = 0;
+        // 15 + 32: largest window, detect the gzip header.
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) return false;
+        break;
+#endif
+#ifdef HTML_PARSER_WITH_ZSTD
+      case source_kind::zstd:
+        zds = ZSTD_createDStream();
+        if (!zds) return false;
+        ZSTD_initDStream(zds);
+        zin.src = input_chunk;
+        zin.size = zin.pos = 0;
+        break;
+#endif
+      default:
+        return false;
+    }
+    source = kind;
+    return true;
+  }
+
+  /**
+   * @brief release the decompressor and the file of a streaming source.
+   * @returns void
+   */
+  void close_stream() {
+    switch (source) {
+      case source_kind::window:
+        fclose(typ);
+        break;
+#ifdef HTML_PARSER_WITH_ZLIB
+      case source_kind::gzip:
+        inflateEnd(&zs);
+        fclose(typ);
+        break;
+#endif
+#ifdef HTML_PARSER_WITH_ZSTD
+      case source_kind::zstd:
+        ZSTD_freeDStream(zds);
+        fclose(typ);
+        break;
+#endif
+      default:
+        break;
+    }
+    source = source_kind::buffer;
+  }
+
+  /**
+   * @brief decompress the next chunk of a streaming source.
+   * @param dst buffer of READER_CHUNK_SIZE bytes
+   * @returns number of bytes written, 0 once the input has ended.
+   */
+  uint64_t decompress(char *dst) {
+    uint64_t written = 0;
+    switch (source) {
+      case source_kind::window:
+        written = fread(dst, 1, READER_CHUNK_SIZE, typ);
+        break;
+#ifdef HTML_PARSER_WITH_ZLIB
+      case source_kind::gzip:
+        zs.next_out = reinterpret_cast<Bytef *>(dst);
+        zs.avail_out = READER_CHUNK_SIZE;
+        while (zs.avail_out == READER_CHUNK_SIZE) {
+          if (zs.avail_in == 0) {
+            zs.next_in = reinterpret_cast<Bytef *>(input_chunk);
+            zs.avail_in = fread(input_chunk, 1, READER_CHUNK_SIZE, typ);
+            if (zs.avail_in == 0) break;
+          }
+          const int ret = inflate(&zs, Z_NO_FLUSH);
+          if (ret == Z_STREAM_END) {
+            // concatenated gzip members continue with the remaining input.
+            inflateReset(&zs);
+          } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            std::cerr << "Error while decompressing gzip input\n";
+            break;
+          }
+        }
+        written = READER_CHUNK_SIZE - zs.avail_out;
+        break;
+#endif
+#ifdef HTML_PARSER_WITH_ZSTD
+      case source_kind::zstd: {
+        ZSTD_outBuffer out = { dst, READER_CHUNK_SIZE, 0 };
+        while (out.pos == 0) {
+          if (zin.pos == zin.size) {
+            zin.size = fread(input_chunk, 1, READER_CHUNK_SIZE, typ);
+            zin.pos = 0;
+            if (zin.size == 0) break;
+          }
+          if (ZSTD_isError(ZSTD_decompressStream(zds, &out, &zin))) {
+            std::cerr << "Error while decompressing zstd input\n";
+            break;
+          }
+        }
+        written = out.pos;
+        break;
+      }
+#endif
+      default:
+        break;
+    }
+    return written;
+  }
+
+  /**
+   * @brief fetch the next chunk of a streaming source, converted to UTF-8.
+   * Slow path of read_next_char.
+   * @returns false if the input has ended.
+   */
+  bool refill() {
+    if (source == source_kind::buffer) return false;
+    index = size = 0;
+    while (index == size) {
+      char *dst = transcoding ? stage_buffer : read_buffer;
+      const uint64_t n = decompress(dst);
+      if (n == 0) return false;
+      index = 0;
+      if (!sniffed) {
+        // the encoding is decided on the first chunk.
+        sniffed = true;
+        size_t bom = 0;
+        bool declared = false;
+        input_encoding = sniff_encoding(dst, n, bom, declared);
+        // a multibyte sequence may be cut at the end of the chunk.
+        if (input_encoding == text_encoding::utf8 && !declared && validate_utf8(dst, n) + 3 < n) {
+          input_encoding = text_encoding::windows_1252;
+        }
+        if (input_encoding != text_encoding::utf8) {
+          transcoding = true;
+          transcoder = utf8_transcoder(input_encoding);
+          std::swap(read_buffer, stage_buffer);
+          std::swap(capacity, stage_capacity);
+          reserve(read_buffer, capacity, utf8_transcoder::max_output(READER_CHUNK_SIZE));
+          size = transcoder.convert(stage_buffer + bom, n - bom, read_buffer);
+          reserve(stage_buffer, stage_capacity, READER_CHUNK_SIZE);
+        } else {
+          index = bom;
+          size = n;
+        }
+        continue;
+      }
+      size = transcoding ? transcoder.convert(stage_buffer, n, read_buffer) : n;
+    }
+    return true;
+  }
 
-#define F_READING    0
-#define SOCK_READING 1
 public:
-  reader (__reader_type &reader, const uint8_t type): typ(reader)  {
+  reader (): read_buffer(nullptr), index(0), size(0), capacity(0),
+    source(source_kind::buffer), input_chunk(nullptr), stage_buffer(nullptr), stage_capacity(0),
+    input_encoding(text_encoding::utf8), borrowed(false), held_buffer(nullptr), held_capacity(0) { }
+
+  reader (__reader_type &reader, const uint8_t type): read_buffer(nullptr), capacity(0),
+    source(source_kind::buffer), input_chunk(nullptr), stage_buffer(nullptr), stage_capacity(0),
+    input_encoding(text_encoding::utf8), borrowed(false), held_buffer(nullptr), held_capacity(0) {
+    load(reader, type);
+  }
+
+  /// the buffers and the stream are owned: a copy would free them twice.
+  reader(const reader &) = delete;
+  reader &operator=(const reader &) = delete;
+
+  /**
+   * @brief (re)initialize the reader with a new input. The buffer is only
+   * reallocated when the new input does not fit in the current one.
+   * gzip and zstd files are recognized by their magic bytes and are
+   * decompressed in READER_CHUNK_SIZE chunks while being read, so the
+   * decompressed input never has to be held in full.
+   * Files larger than READER_WINDOW_THRESHOLD, or any file loaded with
+   * F_WINDOWED_READING, are read through a READER_CHUNK_SIZE window so that
+   * memory stays bounded whatever the size of the input.
+   * The encoding is sniffed (BOM, then <meta charset>) and the input is
+   * converted to UTF-8; input that is already valid UTF-8 is not copied.
+   * @param reader input to read from
+   * @param type F_READING, F_WINDOWED_READING or SOCK_READING
+   * @returns void
+   */
+  void load (__reader_type &reader, const uint8_t type) {
+    close_stream();
+    release_borrowed();
+    typ = reader;
     index = size = 0;
-    uint32_t sz = 0;
+    uint64_t sz = 0;
+    unsigned char magic[4] = { 0, 0, 0, 0 };
     switch(type) {
-      case F_READING: 
-        fseek(reader, 0, SEEK_END);
-        size = ftell(reader);
+      case F_READING:
+        sz = fread(magic, 1, 4, reader);
+        rewind(reader);
+        if (sz >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+          if (!open_stream(source_kind::gzip)) {
+            std::cerr << "gzip input is not supported by this build\n";
+            fclose(reader);
+          }
+          break;
+        }
+        if (sz == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+          if (!open_stream(source_kind::zstd)) {
+            std::cerr << "zstd input is not supported by this build\n";
+            fclose(reader);
+          }
+          break;
+        }
+        fseeko(reader, 0, SEEK_END);
+        size = ftello(reader);
         rewind(reader);
-        read_buffer = new char[size];
+        if (size > READER_WINDOW_THRESHOLD) {
+          // too large to hold: read it through a window instead.
+          size = 0;
+          open_stream(source_kind::window);
+          break;
+        }
+        reserve(read_buffer, capacity, size);
         sz = fread(read_buffer, 1, size, reader);
         fclose(reader);
+        ingest_buffer();
+        break;
+
+      case F_WINDOWED_READING:
+        open_stream(source_kind::window);
         break;
-      
-      case SOCK_READING: 
+
+      case SOCK_READING:
         break;
       default:
         break;
     }
   }
 
+  /**
+   * @brief read from memory owned by the caller, in place: nothing is
+   * copied, data must outlive the reading. The input must be UTF-8.
+   * @param data first character
+   * @param length number of characters
+   * @returns void
+   */
+  void load_memory(const char *data, const uint64_t length) {
+    close_stream();
+    if (!borrowed) {
+      held_buffer = read_buffer;
+      held_capacity = capacity;
+      borrowed = true;
+    }
+    // never written to: the buffer source only reads it.
+    read_buffer = const_cast<char *>(data);
+    capacity = 0;
+    index = 0;
+    size = length;
+    input_encoding = text_encoding::utf8;
+  }
+
+  /**
+   * @brief read a copy of memory owned by the caller, which can be released
+   * as soon as this returns. The buffer is only reallocated when the input
+   * does not fit in it. The encoding is sniffed and converted as for files.
+   * @param data first character
+   * @param length number of characters
+   * @returns void
+   */
+  void load_copy(const char *data, const uint64_t length) {
+    close_stream();
+    release_borrowed();
+    reserve(read_buffer, capacity, length);
+    if (length) memcpy(read_buffer, data, length);
+    index = 0;
+    size = length;
+    ingest_buffer();
+  }
+
+  /**
+   * @brief encoding the input was converted from.
+   * @returns detected encoding
+   */
+  inline text_encoding encoding() const { return input_encoding; }
+
+  /**
+   * @brief memory held by the reader.
+   * @param used set to the bytes of input currently held
+   * @param allocated set to the bytes allocated for all buffers
+   * @returns void
+   */
+  inline void memory_held(uint64_t &used, uint64_t &allocated) const {
+    // borrowed input belongs to the caller.
+    used = borrowed ? 0 : size;
+    allocated = capacity + held_capacity + stage_capacity + (input_chunk ? READER_CHUNK_SIZE : 0);
+  }
+
+  /**
+   * @brief the input left to read, converted to UTF-8, when it is held in memory.
+   * @param data set to the next character
+   * @param length set to the number of characters
+   * @returns false for streaming sources, only a chunk of which is held at a time.
+   */
+  inline bool whole_input(const char *&data, uint64_t &length) const {
+    if (source != source_kind::buffer || !read_buffer) return false;
+    data = read_buffer + index;
+    length = size - index;
+    return true;
+  }
+
   inline char read_next_char() {
-    if (index == size) return EOF;
+    if (index == size && !refill()) return EOF;
     return read_buffer[index++];
   }
-  
-  ~reader() { delete read_buffer; }
+
+  ~reader() {
+    close_stream();
+    release_borrowed();
+    delete[] read_buffer;
+    delete[] input_chunk;
+    delete[] stage_buffer;
+  }
 };
 
 
@@ -0,0 +1,79 @@
+#ifndef __SPSC_QUEUE_HPP_H_
+#define __SPSC_QUEUE_HPP_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free single producer single consumer ring buffer.
+ * Slots are constructed once and written in place, so elements owning
+ * buffers (strings, vectors) keep their capacity while the ring turns.
+ */
+template <typename __value_type>
+class spsc_queue {
+  std::vector<__value_type> slots;         /// ring storage, size is a power of two
+  size_t mask;                             /// slots.size() - 1
+  alignas(64) std::atomic<size_t> head;    /// next slot to read (consumer owned)
+  size_t cached_tail;                      /// consumer's last seen tail
+  alignas(64) std::atomic<size_t> tail;    /// next slot to write (producer owned)
+  size_t cached_head;                      /// producer's last seen head
+
+public:
+  /**
+   * @brief constructor
+   * @param capacity minimum number of slots, rounded up to a power of two
+   */
+  explicit spsc_queue(size_t capacity): head(0), cached_tail(0), tail(0), cached_head(0) {
+    size_t sz = 2;
+    while (sz < capacity) sz <<= 1;
+    slots.resize(sz);
+    mask = sz - 1;
+  }
+
+  /**
+   * @brief producer: get the next free slot to write into.
+   * @returns slot pointer, or nullptr if the queue is full.
+   */
+  inline __value_type *try_reserve() {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cached_head == slots.size()) {
+      // only touch the consumer's cache line when the ring looks full.
+      cached_head = head.load(std::memory_order_acquire);
+      if (t - cached_head == slots.size()) return nullptr;
+    }
+    return &slots[t & mask];
+  }
+
+  /**
+   * @brief producer: publish the slot returned by try_reserve().
+   * @returns void
+   */
+  inline void commit() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief consumer: get the oldest published slot.
+   * @returns slot pointer, or nullptr if the queue is empty.
+   */
+  inline __value_type *try_front() {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (h == cached_tail) {
+      // only touch the producer's cache line when the ring looks empty.
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (h == cached_tail) return nullptr;
+    }
+    return &slots[h & mask];
+  }
+
+  /**
+   * @brief consumer: release the slot returned by try_front().
+   * @returns void
+   */
+  inline void pop() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef __STRING_POOL_HPP_H_
+#define __STRING_POOL_HPP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief Reference-counted intern pool shared by many documents, so that the
+ * strings repeated across pages of one site (class lists, attribute values,
+ * inline styles, boilerplate text) are held once. Thread-safe: the strings
+ * are spread over shards, each behind its own mutex.
+ * Strings shorter than min_length are not interned, as the bookkeeping
+ * would cost more than the copy. A string nobody holds anymore stays in
+ * the pool, in case a later document repeats it, until the idle strings
+ * exceed max_idle_bytes: the least recently released are evicted first.
+ * The pool must outlive every document using it.
+ */
+class string_pool {
+public:
+  /// an interned string
+  class entry {
+    friend class string_pool;
+    std::string text;
+    uint32_t refs;            /// documents holding it, guarded by the shard lock
+    uint32_t shard;
+    entry *older;             /// idle list, while refs is 0
+    entry *newer;
+
+  public:
+    inline std::string_view view() const { return text; }
+  };
+
+private:
+  /// strings of one hash range, one shard per cache line
+  struct alignas(64) shard {
+    std::mutex lock;
+    std::unordered_map<std::string_view, entry *> map;   /// keys view the entries' text
+    entry *oldest_idle = nullptr;                        /// next to evict
+    entry *newest_idle = nullptr;
+    size_t idle_bytes = 0;
+    size_t bytes = 0;                                    /// text of all its entries
+  };
+
+  std::unique_ptr<shard[]> shards;
+  size_t shard_count;
+  size_t min_length;
+  size_t idle_budget;                          /// max_idle_bytes per shard
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+
+  /**
+   * @brief unlink an entry from the idle list of its shard. The shard lock must be held.
+   * @param s shard of the entry
+   * @param e idle entry
+   * @returns void
+   */
+  static void unlink_idle(shard &s, entry *e);
+
+  /**
+   * @brief evict idle entries until the shard is within its budget. The shard lock must be held.
+   * @param s shard
+   * @returns void
+   */
+  void evict_locked(shard &s);
+
+public:
+  /**
+   * @brief create an empty pool.
+   * @param min_length shortest string interned, in bytes
+   * @param max_idle_bytes bytes of strings kept while no document holds them
+   * @param shard_count number of independently locked shards
+   */
+  explicit string_pool(const size_t min_length = 16, const size_t max_idle_bytes = 64ULL << 20,
+    const size_t shard_count = 64);
+
+  string_pool(const string_pool &) = delete;
+  string_pool &operator=(const string_pool &) = delete;
+
+  /**
+   * @brief check whether a string of this length is interned.
+   * @param length length in bytes
+   * @returns true if acquire would intern it
+   */
+  inline bool accepts(const size_t length) const { return length >= min_length; }
+
+  /**
+   * @brief intern a string and hold it, the same entry being returned for
+   * equal strings while it is in the pool.
+   * @param s string to intern
+   * @returns held entry, nullptr if s is shorter than min_length
+   */
+  const entry *acquire(const std::string_view s);
+
+  /**
+   * @brief stop holding an entry. It becomes idle when nobody else holds it.
+   * @param e entry returned by acquire
+   * @returns void
+   */
+  void release(const entry *e);
+
+  /**
+   * @brief bytes of text held by the pool, idle strings included.
+   * @returns total size of the interned strings
+   */
+  size_t bytes() const;
+
+  /**
+   * @brief bytes of text no document holds.
+   * @returns total size of the idle strings
+   */
+  size_t idle_bytes() const;
+
+  /**
+   * @brief acquires that found the string already interned.
+   * @returns hit count
+   */
+  inline uint64_t hit_count() const { return hits.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief acquires that interned a new string.
+   * @returns miss count
+   */
+  inline uint64_t miss_count() const { return misses.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief destructor: frees every string. No document may still use the pool.
+   */
+  ~string_pool();
+};
+
+#endif
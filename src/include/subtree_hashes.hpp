@@ -0,0 +1,153 @@
+#ifndef __SUBTREE_HASHES_HPP_H_
+#define __SUBTREE_HASHES_HPP_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "dom_element.hpp"
+
+/**
+ * @brief Merkle hashes of subtrees, kept in a table on the side so that
+ * nodes pay nothing when no hash is asked for. The hash of a node covers its
+ * kind, tag, attributes in any order, text, and the hashes of its child
+ * nodes in order: equal subtrees have equal hashes, and two versions of a
+ * tree can be compared without walking their unchanged parts.
+ * Hashes are computed bottom-up on demand and cached by node address. A
+ * change below a node makes its entry and its ancestors' stale: call
+ * invalidate after changing a tree, and forget before freeing one.
+ * html_parser::set_subtree_hashing keeps a table up to date for its document.
+ * The hash function does not depend on the standard library, so hashes can
+ * be stored with a snapshot. Not thread-safe: lookups may fill the table.
+ */
+class subtree_hashes {
+public:
+  /// kind of a tree_change
+  enum class change_kind : uint8_t {
+    removed,          /// before is not in the new tree
+    inserted,         /// after is not in the old tree
+    modified          /// same kind and tag, other attributes or text; the children are compared apart
+  };
+
+  /// a difference found by diff
+  struct tree_change {
+    change_kind kind;
+    const dom_element *before;   /// node of the old tree, nullptr if inserted
+    const dom_element *after;    /// node of the new tree, nullptr if removed
+  };
+
+private:
+  /// cached hash of a subtree
+  struct entry {
+    uint64_t hash;
+    uint32_t nodes;              /// nodes in the subtree, its root included
+  };
+
+  std::unordered_map<const dom_element *, entry> table;
+
+  /**
+   * @brief hash of a node's own data: kind, tag, attributes and text.
+   * @param x node
+   * @returns hash, independent of the order of the attributes
+   */
+  static uint64_t own_hash(const dom_element *x);
+
+  /**
+   * @brief entry of a subtree, computing the missing ones below it.
+   * @param root root of the subtree
+   * @returns cached entry
+   */
+  const entry &compute(const dom_element *root);
+
+  /**
+   * @brief entry of a node already hashed.
+   * @param x node
+   * @returns cached entry
+   */
+  inline const entry &stored(const dom_element *x) const { return table.find(x)->second; }
+
+  /**
+   * @brief add the differences between two hashed subtrees of the same kind
+   * and tag to a diff.
+   * @param a node of the old tree
+   * @param b node of the new tree
+   * @param changes output list
+   * @returns void
+   */
+  void diff_into(const dom_element *a, const dom_element *b, std::vector<tree_change> &changes) const;
+
+public:
+  /**
+   * @brief Merkle hash of a subtree, computed on the first call.
+   * @param node root of the subtree
+   * @returns hash, the same across runs for the same markup
+   */
+  inline uint64_t hash(const dom_element *node) { return compute(node).hash; }
+
+  /**
+   * @brief compare two subtrees in O(1) once hashed, without serializing them.
+   * Different subtrees compare equal only on a 64-bit hash collision.
+   * @param a subtree
+   * @param b subtree to compare with
+   * @returns true if both have the same structure and content
+   */
+  inline bool equals(const dom_element *a, const dom_element *b) { return hash(a) == hash(b); }
+
+  /**
+   * @brief differences between two versions of a tree, such as two snapshots
+   * of a page. Subtrees with the same hash are skipped in O(1), so the cost
+   * follows the size of the changed part. Children are aligned by hash:
+   * a moved node shows as removed and inserted.
+   * @param before old tree
+   * @param after new tree
+   * @returns changes in document order
+   */
+  std::vector<tree_change> diff(const dom_element *before, const dom_element *after);
+
+  /**
+   * @brief hashes of the subtrees repeated across documents, such as the
+   * navigation and footer of a site. Only the outermost repeated subtree is
+   * reported, not the ones inside it.
+   * @param documents documents to compare
+   * @param min_documents number of documents a subtree must appear in
+   * @param min_nodes smallest subtree reported, in nodes
+   * @returns hashes in the order of the first document they appear in
+   */
+  std::vector<uint64_t> boilerplate(const std::vector<const dom_element *> &documents, const size_t min_documents,
+    const uint32_t min_nodes = 8);
+
+  /**
+   * @brief drop the entries of a node and its ancestors, after a change below
+   * it (an element removed with delete_dom_from_document, for instance).
+   * @param node deepest node whose subtree changed
+   * @returns void
+   */
+  void invalidate(const dom_element *node);
+
+  /**
+   * @brief drop the entries of a subtree, before it is freed or reused.
+   * @param root root of the subtree
+   * @returns void
+   */
+  void forget(const dom_element *root);
+
+  /**
+   * @brief drop every entry.
+   * @returns void
+   */
+  inline void clear() { table.clear(); }
+
+  /**
+   * @brief number of hashed nodes.
+   * @returns entry count
+   */
+  inline size_t size() const { return table.size(); }
+
+  /**
+   * @brief add the memory held by the table.
+   * @param category category to add to
+   * @returns void
+   */
+  void memory_report(memory_category &category) const;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef __THREAD_POOL_HPP_H_
+#define __THREAD_POOL_HPP_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads running parallel loops. The thread
+ * calling parallel_for works on the loop too, so a pool of n threads keeps
+ * n + 1 cores busy. One loop runs at a time.
+ */
+class thread_pool {
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::mutex run_lock;                        /// serializes callers of parallel_for
+  std::condition_variable start_cv, done_cv;
+  const std::function<void(size_t)> *job;     /// body of the current loop
+  size_t job_size;                            /// iterations of the current loop
+  std::atomic<size_t> next;                   /// next iteration to claim
+  size_t generation;                          /// bumped for every loop
+  size_t busy;                                /// workers still on the current loop
+  bool stopping;
+
+  /**
+   * @brief claim and run iterations of the current loop until none is left.
+   * @returns void
+   */
+  void drain();
+
+public:
+  /**
+   * @brief start the workers.
+   * @param threads number of worker threads, the caller of parallel_for not included.
+   */
+  explicit thread_pool(size_t threads = std::thread::hardware_concurrency() - 1);
+
+  /**
+   * @brief number of threads working on a loop, the caller included.
+   * @returns worker count + 1
+   */
+  inline size_t concurrency() const { return workers.size() + 1; }
+
+  /**
+   * @brief run fn(0) ... fn(n - 1) across the pool and wait for all of them.
+   * @param n number of iterations
+   * @param fn loop body, called concurrently from several threads
+   * @returns void
+   */
+  void parallel_for(const size_t n, const std::function<void(size_t)> &fn);
+
+  ~thread_pool();
+};
+
+/**
+ * @brief How a query is evaluated: on the calling thread, or split into
+ * document-order pieces run on a thread pool, the results being merged back
+ * in document order.
+ */
+struct execution_policy {
+  thread_pool *pool;   /// pool to run on, nullptr for sequential evaluation
+  size_t tasks;        /// pieces the tree is split into, 0 for 4 per thread
+
+  /**
+   * @brief number of pieces to split a query into.
+   * @returns 1 when sequential
+   */
+  inline size_t task_count() const {
+    if (!pool) return 1;
+    return tasks ? tasks : 4 * pool->concurrency();
+  }
+};
+
+/// evaluate on the calling thread
+static const execution_policy sequential_execution = { nullptr, 0 };
+
+/**
+ * @brief policy running on a pool.
+ * @param pool thread pool to use
+ * @param tasks pieces to split queries into, 0 for 4 per thread
+ * @returns the policy
+ */
+inline execution_policy parallel_execution(thread_pool &pool, const size_t tasks = 0) {
+  return execution_policy{ &pool, tasks };
+}
+
+#endif
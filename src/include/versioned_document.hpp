@@ -0,0 +1,347 @@
+#ifndef __VERSIONED_DOCUMENT_HPP_H_
+#define __VERSIONED_DOCUMENT_HPP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dom_element.hpp"
+
+/**
+ * @brief Copy-on-write document shared between reader threads and a writer.
+ * Nodes are immutable and have no parent pointer, so a subtree can belong to
+ * many versions at once: a mutation copies only the nodes on the path from
+ * the root to each changed node (path copying), shares everything else, and
+ * publishes the new root with an atomic store.
+ * Readers pin a snapshot and query it without any lock. Nodes that the new
+ * version no longer reaches are retired with the epoch at which they were
+ * unlinked, and freed once no pinned snapshot is older (epoch-based
+ * reclamation). Writers are serialized among themselves by a mutex that
+ * readers never take.
+ */
+class versioned_document {
+public:
+  /// immutable node of a version, shared by the versions that did not change it
+  class node {
+    friend class versioned_document;
+    std::string tag;                                           /// tag name, empty for text nodes
+    std::string text;                                          /// text or comment content
+    std::string id;                                            /// id attribute
+    std::vector<std::string> class_list;                       /// class names
+    std::vector<std::pair<std::string, std::string>> attr;     /// attributes
+    std::vector<const node *> child_nodes;                     /// child nodes, text nodes included
+    bool is_text_node;
+    bool is_comment;
+    bool is_non_terminating;
+    bool is_document;                                          /// root of a parsed document
+
+  public:
+    inline const std::string &tag_name() const { return tag; }
+    inline const std::string &get_id() const { return id; }
+    inline bool is_a_text_node() const { return is_text_node; }
+    inline bool is_a_comment() const { return is_comment; }
+    inline const std::vector<const node *> &get_child_nodes() const { return child_nodes; }
+
+    /**
+     * @brief check whether the node has a class
+     * @param classname name of class to check
+     * @returns true if the class exists
+     */
+    inline bool has_classname(const std::string &classname) const {
+      for (auto &x: class_list) {
+        if (classname == x) return true;
+      }
+      return false;
+    }
+
+    /**
+     * @brief find an attribute.
+     * @param attribute_name the name of attribute.
+     * @returns pointer to the value, nullptr if the attribute does not exist.
+     */
+    const std::string *find_attribute(const std::string &attribute_name) const;
+
+    /**
+     * @brief check whether the node has an attribute.
+     * @param attribute_name the name of attribute.
+     * @returns true if the attribute exists
+     */
+    inline bool has_attribute(const std::string &attribute_name) const { return find_attribute(attribute_name); }
+
+    /**
+     * @brief Get attribute value of the node.
+     * @param attribute_name the name of attribute.
+     * @returns attribute value, empty if the attribute does not exist.
+     */
+    std::string get_attribute_value(const std::string &attribute_name) const;
+
+    /**
+     * @brief returns the inner text, as dom_element::innerText does.
+     * @returns the text of the text nodes below
+     */
+    std::string innerText() const;
+
+    /**
+     * @brief serialize the node, as dom_element::innerHTML does.
+     * @returns the innerHTML of this node
+     */
+    std::string innerHTML() const;
+
+  private:
+    /**
+     * @brief serialize into a buffer.
+     * @param buffop output buffer
+     * @returns void
+     */
+    void construct_innerHTML(std::string &buffop) const;
+  };
+
+private:
+  /// a published version
+  struct version_record {
+    const node *root;
+    uint64_t number;
+  };
+
+  /// epoch pinned by one reader, 0 when the slot is free, one per cache line
+  struct alignas(64) reader_slot {
+    std::atomic<uint64_t> epoch;
+  };
+
+  /// nodes unlinked from the current version, freed once no reader is older than epoch
+  struct retired_batch {
+    uint64_t epoch;
+    const version_record *record;
+    std::vector<const node *> nodes;
+  };
+
+  /// what a rewrite does to the elements it matches
+  enum class edit_kind : uint8_t { remove_element, set_attribute, remove_attribute };
+
+  struct edit {
+    edit_kind kind;
+    const std::function<bool(const node &)> *match;
+    const std::string *name;
+    const std::string *value;
+  };
+
+  std::atomic<const version_record *> current;
+  std::atomic<uint64_t> current_number;   /// number of current, readable without pinning the record
+  std::atomic<uint64_t> global_epoch;
+  std::unique_ptr<reader_slot[]> slots;
+  size_t slot_count;
+  std::mutex writer;                      /// serializes writers, never taken by readers
+  std::vector<retired_batch> retired;     /// guarded by writer
+
+  /**
+   * @brief copy a dom_element subtree.
+   * @param dom element to copy
+   * @returns new node
+   */
+  static node *copy_tree(const dom_element *dom);
+
+  /**
+   * @brief text node holding one space.
+   * @returns new node
+   */
+  static node *space_node();
+
+  /**
+   * @brief free a subtree, for nodes that no version reaches anymore.
+   * @param x root of the subtree
+   * @returns void
+   */
+  static void free_tree(const node *x);
+
+  /**
+   * @brief add a subtree to a list of nodes to retire.
+   * @param x root of the subtree
+   * @param nodes output list
+   * @returns void
+   */
+  static void retire_tree(const node *x, std::vector<const node *> &nodes);
+
+  /**
+   * @brief check whether an attribute edit changes an element.
+   * @param e edit
+   * @param x element
+   * @returns false if the attribute already has the requested state
+   */
+  static bool changes_fields(const edit &e, const node &x);
+
+  /**
+   * @brief apply an attribute edit to the element's own fields.
+   * @param e edit
+   * @param x copy of the element to modify
+   * @returns void
+   */
+  static void apply_to_fields(const edit &e, node *x);
+
+  /**
+   * @brief apply an edit to a node and below it, copying only the nodes whose
+   * subtree changes.
+   * @param e edit
+   * @param x node of the current version
+   * @param matchable x itself can be edited (false for the root)
+   * @param changed incremented per changed element
+   * @param unlinked nodes of the current version that the result no longer reaches
+   * @returns x itself if nothing below it changed, else its modified copy
+   */
+  static const node *rewrite(const edit &e, const node *x, const bool matchable, size_t &changed,
+    std::vector<const node *> &unlinked);
+
+  /**
+   * @brief run an edit and publish the result as a new version.
+   * @param e edit
+   * @returns number of elements changed, no version is published for 0
+   */
+  size_t commit(const edit &e);
+
+  /**
+   * @brief free the retired batches older than every pinned snapshot.
+   * The writer mutex must be held.
+   * @returns void
+   */
+  void reclaim_locked();
+
+public:
+  /**
+   * @brief pinned version of the document. While it is alive, the nodes it
+   * reaches are not freed, whatever the writers do. Movable, not copyable.
+   */
+  class snapshot {
+    friend class versioned_document;
+    reader_slot *slot;
+    const version_record *record;
+
+    snapshot(reader_slot *slot, const version_record *record): slot(slot), record(record) {}
+
+  public:
+    snapshot(snapshot &&other): slot(other.slot), record(other.record) { other.slot = nullptr; }
+    snapshot &operator=(snapshot &&other);
+    snapshot(const snapshot &) = delete;
+    snapshot &operator=(const snapshot &) = delete;
+
+    /**
+     * @brief unpin the version.
+     */
+    ~snapshot();
+
+    /**
+     * @brief root of the pinned version, the document node.
+     * @returns root node
+     */
+    inline const node *root() const { return record->root; }
+
+    /**
+     * @brief number of the pinned version, 0 for the version built by the constructor.
+     * @returns version number
+     */
+    inline uint64_t version() const { return record->number; }
+
+    /**
+     * @brief Get element by id, as dom_element::get_element_by_id does.
+     * @param id Element id
+     * @returns Pointer to the element, if exists, else returns nullptr.
+     */
+    const node *get_element_by_id(const std::string &id) const;
+
+    /**
+     * @brief get all the elements having a tag name, in document order.
+     * @param tagname name of tag
+     * @returns list of nodes
+     */
+    std::vector<const node *> get_elements_by_tag_name(const std::string &tagname) const;
+
+    /**
+     * @brief get the elements having a class name, as
+     * dom_element::get_elements_by_class_name does: not below a match.
+     * @param classname name of class to retrieve
+     * @returns list of nodes
+     */
+    std::vector<const node *> get_elements_by_class_name(const std::string &classname) const;
+
+    /**
+     * @brief full scan: get all the elements for which a predicate holds.
+     * @param predicate test of an element
+     * @returns list of nodes in document order
+     */
+    std::vector<const node *> get_elements_if(const std::function<bool(const node &)> &predicate) const;
+  };
+
+  /**
+   * @brief copy a parsed document as version 0.
+   * @param root document to copy, it is not modified.
+   * @param max_readers number of snapshots that can be pinned at the same time
+   */
+  explicit versioned_document(const dom_element *root, const size_t max_readers = 64);
+
+  versioned_document(const versioned_document &) = delete;
+  versioned_document &operator=(const versioned_document &) = delete;
+
+  /**
+   * @brief pin the current version, lock-free. Waits (yielding) only when
+   * max_readers snapshots are already pinned.
+   * @returns snapshot of the current version
+   */
+  snapshot pin();
+
+  /**
+   * @brief number of the current version. It may be newer than the version a
+   * snapshot pinned just before: use snapshot::version() for that one.
+   * @returns version number
+   */
+  inline uint64_t version() const { return current_number.load(std::memory_order_acquire); }
+
+  /**
+   * @brief remove the elements matching a predicate, with their subtrees,
+   * as delete_dom_from_document does. Matches are not searched below a removed element.
+   * @param match test of an element
+   * @returns number of elements removed
+   */
+  size_t remove_elements_if(const std::function<bool(const node &)> &match);
+
+  /**
+   * @brief remove one node of the current version.
+   * @param x element to remove
+   * @returns true if x was found and removed
+   */
+  bool remove_node(const node *x);
+
+  /**
+   * @brief set an attribute on the elements matching a predicate. The id and
+   * class list follow the id and class attributes.
+   * @param match test of an element
+   * @param attribute_name the name of attribute.
+   * @param value new value
+   * @returns number of elements changed
+   */
+  size_t set_attribute_if(const std::function<bool(const node &)> &match, const std::string &attribute_name,
+    const std::string &value);
+
+  /**
+   * @brief remove an attribute from the elements matching a predicate.
+   * @param match test of an element
+   * @param attribute_name the name of attribute.
+   * @returns number of elements changed
+   */
+  size_t remove_attribute_if(const std::function<bool(const node &)> &match, const std::string &attribute_name);
+
+  /**
+   * @brief free what the retired versions hold, if no pinned snapshot needs it.
+   * Writers also do it after each commit.
+   * @returns number of retired batches still waiting for readers
+   */
+  size_t reclaim();
+
+  /**
+   * @brief destructor: frees every version. No snapshot may outlive the document.
+   */
+  ~versioned_document();
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef __XPATH_HPP_H_
+#define __XPATH_HPP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "dom_element.hpp"
+
+/**
+ * @brief XPath 1.0 subset compiled once into a list of steps and evaluated
+ * directly on dom_element trees.
+ * Supported: absolute and relative location paths, '/' (child) and '//'
+ * (descendant-or-self) separators, name, '*' and text() node tests, a final
+ * attribute step (@name or @*), and predicates, chained with [...][...]:
+ *   [N] [last()] [last()-N] [position() op N] with op in = != < <= > >=
+ *   [@name] [@name='v'] [@name!='v'] [contains(@name,'v')]
+ * Every step produces its nodes in document order without duplicates, so no
+ * sorting is needed; positions are counted among the children of each parent,
+ * as in XPath ('//td[2]' is the second td of each row).
+ * Evaluation only reads the document: threads can evaluate on the same
+ * document at once, as long as none changes it meanwhile.
+ */
+class xpath {
+  enum class axis : uint8_t { child, descendant };
+  enum class node_test : uint8_t { name, any, text, attribute };
+  enum class predicate_kind : uint8_t { position, has_attribute, attribute_equals, attribute_not_equals, attribute_contains };
+  enum class compare : uint8_t { eq, ne, lt, le, gt, ge };
+
+  struct predicate {
+    predicate_kind kind;
+    compare op;            /// position: comparison with number
+    bool from_last;        /// position: number is counted from last()
+    int64_t number;        /// position: value compared with position()
+    std::string name;      /// attribute name
+    std::string value;     /// attribute value
+  };
+
+  struct step {
+    axis ax;
+    node_test test;
+    std::string name;                  /// tag or attribute name
+    std::vector<predicate> predicates;
+    bool positional;                   /// some predicate depends on position()
+  };
+
+  std::vector<step> steps;
+  bool absolute;
+  std::string error_message;
+
+  /**
+   * @brief parse one step, with its predicates.
+   * @param expression text of the expression
+   * @param i position in expression, advanced past the step
+   * @param s step to fill
+   * @returns false on a syntax error, error_message is set
+   */
+  bool parse_step(const std::string &expression, size_t &i, step &s);
+
+  /**
+   * @brief parse one predicate, the '[' being consumed.
+   * @param expression text of the expression
+   * @param i position in expression, advanced past the ']'
+   * @param p predicate to fill
+   * @returns false on a syntax error, error_message is set
+   */
+  bool parse_predicate(const std::string &expression, size_t &i, predicate &p);
+
+  /**
+   * @brief record a syntax error.
+   * @param what description of the error
+   * @param i position of the error
+   * @returns false
+   */
+  bool fail(const std::string &what, const size_t i);
+
+  /**
+   * @brief node test of a step on a node.
+   * @param s step
+   * @param x node
+   * @returns true if x passes
+   */
+  static bool test_node(const step &s, const dom_element *x);
+
+  /**
+   * @brief evaluate a predicate on a node.
+   * @param p predicate
+   * @param x node
+   * @param position position of x among the candidates, from 1
+   * @param size number of candidates
+   * @returns true if x is kept
+   */
+  static bool test_predicate(const predicate &p, const dom_element *x, const size_t position, const size_t size);
+
+  /**
+   * @brief children of a node passing a step, in document order.
+   * @param s step
+   * @param parent node whose children are tested
+   * @param kept output list
+   * @returns void
+   */
+  static void select_children(const step &s, const dom_element *parent, std::vector<const dom_element *> &kept);
+
+  /**
+   * @brief apply a step to the children, or all the descendants, of a node.
+   * @param s step
+   * @param parent context node
+   * @param recursive also apply it below every descendant (the '//' axis)
+   * @param members context nodes when the context set is nested, nullptr otherwise:
+   * the subtree is then walked and the step applied below the members only.
+   * @param out output list, appended in document order
+   * @returns void
+   */
+  static void expand(const step &s, const dom_element *parent, const bool recursive,
+    const std::vector<const dom_element *> *members, std::vector<const dom_element *> &out);
+
+  /**
+   * @brief evaluate the element steps of the path.
+   * @param context context node of a relative path
+   * @returns nodes selected by the steps before a final attribute step
+   */
+  std::vector<const dom_element *> evaluate(const dom_element *context) const;
+
+public:
+  /**
+   * @brief compile an expression.
+   * @param expression XPath expression of the supported subset
+   */
+  explicit xpath(const std::string &expression);
+
+  /**
+   * @brief whether the expression compiled.
+   * @returns false on a syntax error or an unsupported construct
+   */
+  inline bool valid() const { return error_message.empty(); }
+
+  /**
+   * @brief the compilation error.
+   * @returns description of the error, with its position, empty if valid
+   */
+  inline const std::string &error() const { return error_message; }
+
+  /**
+   * @brief select nodes. For a path ending with an attribute step, the
+   * elements having the attribute are returned.
+   * @param context context node, any node of the tree for an absolute path
+   * @returns elements or text nodes in document order
+   */
+  std::vector<dom_element *> select(const dom_element *context) const;
+
+  /**
+   * @brief select string values: attribute values for a path ending with an
+   * attribute step, the text of text nodes, the innerText of elements.
+   * @param context context node, any node of the tree for an absolute path
+   * @returns values in document order
+   */
+  std::vector<std::string> select_strings(const dom_element *context) const;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include <cstring>
+#include "include/link_extractor.hpp"
+#include "include/html_parser.hpp"
+
+static inline bool is_a_whitespace(const char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f'; }
+static inline bool is_alpha(const char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+static inline char char_to_lowercase(const char c) { return is_alpha(c) ? (c | 32) : c; }
+/// same as html_tokenizer::is_name_char
+static inline bool is_name_char(const char c) { return !is_a_whitespace(c) && c != '>' && c != '/' && c != '='; }
+
+/**
+ * @brief compare a name with a lowercase name, ignoring case.
+ * @param name name as written
+ * @param lower lowercase name
+ * @returns true if they are equal
+ */
+static inline bool equals_lowercase(const std::string_view name, const char *lower) {
+  size_t i = 0;
+  for (; i < name.size(); ++i) {
+    if (!lower[i] || char_to_lowercase(name[i]) != lower[i]) return false;
+  }
+  return !lower[i];
+}
+
+static inline const char *skip_whitespaces(const char *p, const char *end) {
+  while (p < end && is_a_whitespace(*p)) ++p;
+  return p;
+}
+
+static inline const char *find_char(const char *p, const char *end, const char c) {
+  const char *found = static_cast<const char *>(memchr(p, c, end - p));
+  return found ? found : end;
+}
+
+void link_extractor::emit_srcset(const char *begin, const std::string_view value, const std::string_view tag) {
+  // "url [descriptor], url [descriptor], ..."
+  size_t i = 0;
+  while (i < value.size()) {
+    while (i < value.size() && (is_a_whitespace(value[i]) || value[i] == ',')) ++i;
+    const size_t start = i;
+    while (i < value.size() && !is_a_whitespace(value[i])) ++i;
+    size_t stop = i;
+    // a trailing comma separates candidates that have no descriptor.
+    while (stop > start && value[stop - 1] == ',') --stop;
+    if (stop > start) {
+      links.push_back(link{ value.substr(start, stop - start), static_cast<uint64_t>(value.data() + start - begin),
+        tag, link_attribute::srcset });
+    }
+    while (i < value.size() && value[i] != ',') ++i;
+  }
+}
+
+void link_extractor::read_attributes(const char *begin, const char *&p, const char *end, const std::string_view tag,
+  const bool is_base) {
+  while (true) {
+    p = skip_whitespaces(p, end);
+    if (p == end) return;
+    if (*p == '/') {
+      ++p;
+      if (p < end && *p == '>') {
+        ++p;
+        return;
+      }
+      continue;
+    }
+    if (*p == '>') {
+      ++p;
+      return;
+    }
+    // a name starting with '=' keeps it, as in html_tokenizer.
+    const char *name_begin = p;
+    if (*p == '=') ++p;
+    while (p < end && is_name_char(*p)) ++p;
+    const std::string_view name(name_begin, p - name_begin);
+    p = skip_whitespaces(p, end);
+    if (p == end || *p != '=') continue;
+    p = skip_whitespaces(p + 1, end);
+    const char *value_begin = p;
+    std::string_view value;
+    if (p < end && (*p == '"' || *p == '\'')) {
+      const char quote = *p;
+      value_begin = ++p;
+      p = find_char(p, end, quote);
+      value = std::string_view(value_begin, p - value_begin);
+      if (p < end) ++p;
+    } else {
+      while (p < end && !is_a_whitespace(*p) && *p != '>') ++p;
+      value = std::string_view(value_begin, p - value_begin);
+    }
+    if (name.size() < 3 || name.size() > 6) continue;
+    link_attribute kind;
+    if (equals_lowercase(name, "href")) {
+      kind = link_attribute::href;
+      if (is_base && base_url.empty()) base_url = value;
+    } else if (equals_lowercase(name, "src")) {
+      kind = link_attribute::src;
+    } else if (equals_lowercase(name, "action")) {
+      kind = link_attribute::action;
+    } else if (equals_lowercase(name, "srcset")) {
+      emit_srcset(begin, value, tag);
+      continue;
+    } else {
+      continue;
+    }
+    links.push_back(link{ value, static_cast<uint64_t>(value_begin - begin), tag, kind });
+  }
+}
+
+const std::vector<link_extractor::link> &link_extractor::extract(const char *data, const size_t size) {
+  links.clear();
+  base_url = std::string_view();
+  const char *p = data;
+  const char *end = data + size;
+  while ((p = find_char(p, end, '<')) < end) {
+    if (++p == end) break;
+    if (*p == '!') {
+      if (end - p >= 3 && p[1] == '-' && p[2] == '-') {
+        // "<!--": skip till "-->"
+        const size_t found = std::string_view(p + 3, end - p - 3).find("-->");
+        p = found == std::string_view::npos ? end : p + 3 + found + 3;
+      } else {
+        p = find_char(p, end, '>');
+      }
+      continue;
+    }
+    if (*p == '/' || *p == '?') {
+      // end tags and processing instructions carry no URL.
+      p = find_char(p, end, '>');
+      continue;
+    }
+    // a lone '<' is text.
+    if (!is_alpha(*p)) continue;
+    const char *tag_begin = p;
+    while (p < end && is_name_char(*p)) ++p;
+    const std::string_view tag(tag_begin, p - tag_begin);
+    name_scratch.clear();
+    for (auto c: tag) name_scratch.push_back(char_to_lowercase(c));
+    read_attributes(data, p, end, tag, name_scratch == "base");
+    if (html_parser::p_text_tag.find(name_scratch) == html_parser::p_text_tag.end()) continue;
+    // raw text: skip till the end tag, as html_tokenizer::read_raw_text does.
+    while ((p = find_char(p, end, '<')) < end) {
+      const char *q = p + 1;
+      if (q < end && *q == '/') {
+        size_t i = 0;
+        ++q;
+        while (q < end && i < name_scratch.size() && char_to_lowercase(*q) == name_scratch[i]) {
+          ++q;
+          ++i;
+        }
+        if (i == name_scratch.size() && (q == end || *q == '>' || *q == '/' || is_a_whitespace(*q))) break;
+      }
+      ++p;
+    }
+  }
+  return links;
+}
+
+const std::vector<link_extractor::link> &link_extractor::extract_file(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    std::cerr << "Unable to open " << path << "\n";
+    links.clear();
+    base_url = std::string_view();
+    return links;
+  }
+  rd.load(file, F_READING);
+  const char *data = nullptr;
+  uint64_t size = 0;
+  if (!rd.whole_input(data, size)) {
+    // compressed or windowed input: gather it first.
+    stream_copy.clear();
+    char c;
+    while ((c = rd.read_next_char()) != EOF) stream_copy.push_back(c);
+    data = stream_copy.data();
+    size = stream_copy.size();
+  }
+  return extract(data, size);
+}
+
+std::string link_extractor::resolve(const std::string_view url) const {
+  // absolute URL: a scheme is followed by ':' before any '/', '?' or '#'.
+  const size_t colon = url.find_first_of(":/?#");
+  if (colon != std::string_view::npos && colon > 0 && url[colon] == ':' && is_alpha(url[0])) {
+    return std::string(url);
+  }
+  const size_t scheme_end = base_url.find("://");
+  if (scheme_end == std::string_view::npos) return std::string(url);
+  const size_t authority_end = std::min(base_url.find_first_of("/?#", scheme_end + 3), base_url.size());
+  if (url.size() >= 2 && url[0] == '/' && url[1] == '/') {
+    return std::string(base_url.substr(0, scheme_end + 1)).append(url);
+  }
+  std::string path;
+  if (url.empty() || url[0] == '#') {
+    return std::string(base_url.substr(0, std::min(base_url.find('#'), base_url.size()))).append(url);
+  } else if (url[0] == '?') {
+    return std::string(base_url.substr(0, std::min(base_url.find_first_of("?#"), base_url.size()))).append(url);
+  } else if (url[0] == '/') {
+    path = std::string(url);
+  } else {
+    // merge with the directory of the base path.
+    const std::string_view base_path = base_url.substr(authority_end,
+      std::min(base_url.find_first_of("?#", authority_end), base_url.size()) - authority_end);
+    const size_t slash = base_path.rfind('/');
+    path = slash == std::string_view::npos ? "/" : std::string(base_path.substr(0, slash + 1));
+    path.append(url);
+  }
+  // remove the dot segments of the path, the query and fragment are kept.
+  const size_t suffix_begin = std::min(path.find_first_of("?#"), path.size());
+  std::string output;
+  size_t i = 0;
+  while (i < suffix_begin) {
+    size_t next = path.find('/', i + 1);
+    if (next == std::string::npos || next > suffix_begin) next = suffix_begin;
+    const std::string_view segment(path.data() + i, next - i);
+    if (segment == "/..") {
+      const size_t last = output.rfind('/');
+      output.resize(last == std::string::npos ? 0 : last);
+      if (next == suffix_begin) output.push_back('/');
+    } else if (segment == "/.") {
+      if (next == suffix_begin) output.push_back('/');
+    } else {
+      output.append(segment);
+    }
+    i = next;
+  }
+  output.append(path, suffix_begin, std::string::npos);
+  return std::string(base_url.substr(0, authority_end)).append(output);
+}
@@ -0,0 +1,66 @@
+#include "include/query_batch.hpp"
+
+query_batch::query_id query_batch::add(std::unordered_map<std::string, std::vector<query_id>> &index,
+  const std::string &key, const query_kind kind, const std::string &value, const bool any_value) {
+  const query_id id = queries.size();
+  queries.push_back(query{ kind, value, any_value });
+  matches.emplace_back();
+  inside.push_back(nullptr);
+  index[key].push_back(id);
+  return id;
+}
+
+void query_batch::run(const dom_element *root) {
+  for (auto &x: matches) x.clear();
+  for (auto &x: inside) x = nullptr;
+  visit(root);
+}
+
+void query_batch::visit(const dom_element *node) {
+  for (const auto &x: node->children) {
+    if (!by_tag.empty()) {
+      auto found = by_tag.find(x->tag);
+      if (found != by_tag.end()) {
+        for (auto q: found->second) matches[q].push_back(x);
+      }
+    }
+    if (!by_id.empty() && x->id.size()) {
+      auto found = by_id.find(x->id);
+      if (found != by_id.end()) {
+        for (auto q: found->second) {
+          // only the first element in document order.
+          if (matches[q].empty()) matches[q].push_back(x);
+        }
+      }
+    }
+    if (!by_attribute.empty()) {
+      for (auto &a: x->attr) {
+        auto found = by_attribute.find(a.first);
+        if (found == by_attribute.end()) continue;
+        for (auto q: found->second) {
+          if (queries[q].any_value || queries[q].value == a.second) matches[q].push_back(x);
+        }
+      }
+    }
+    bool opened = false;
+    if (!by_class.empty()) {
+      for (auto &c: x->class_list) {
+        auto found = by_class.find(c);
+        if (found == by_class.end()) continue;
+        for (auto q: found->second) {
+          // a class match is not searched further, as in get_elements_by_class_name.
+          if (inside[q]) continue;
+          matches[q].push_back(x);
+          inside[q] = x;
+          opened = true;
+        }
+      }
+    }
+    visit(x);
+    if (opened) {
+      for (auto &x_inside: inside) {
+        if (x_inside == x) x_inside = nullptr;
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#include <functional>
+#include "include/string_pool.hpp"
+
+string_pool::string_pool(const size_t min_length, const size_t max_idle_bytes, const size_t shard_count):
+  shards(new shard[shard_count ? shard_count : 1]), shard_count(shard_count ? shard_count : 1),
+  min_length(min_length ? min_length : 1), idle_budget(max_idle_bytes / (shard_count ? shard_count : 1)),
+  hits(0), misses(0) { }
+
+void string_pool::unlink_idle(shard &s, entry *e) {
+  (e->older ? e->older->newer : s.oldest_idle) = e->newer;
+  (e->newer ? e->newer->older : s.newest_idle) = e->older;
+  e->older = e->newer = nullptr;
+  s.idle_bytes -= e->text.size();
+}
+
+void string_pool::evict_locked(shard &s) {
+  while (s.idle_bytes > idle_budget) {
+    entry *e = s.oldest_idle;
+    unlink_idle(s, e);
+    s.map.erase(e->view());
+    s.bytes -= e->text.size();
+    delete e;
+  }
+}
+
+const string_pool::entry *string_pool::acquire(const std::string_view s) {
+  if (s.size() < min_length) {
+    return nullptr;
+  }
+  const size_t hash = std::hash<std::string_view>()(s);
+  const uint32_t index = static_cast<uint32_t>(hash % shard_count);
+  shard &sh = shards[index];
+  std::lock_guard<std::mutex> lock(sh.lock);
+  auto found = sh.map.find(s);
+  if (found != sh.map.end()) {
+    entry *e = found->second;
+    if (e->refs++ == 0) unlink_idle(sh, e);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return e;
+  }
+  entry *e = new entry();
+  e->text.assign(s.data(), s.size());
+  e->refs = 1;
+  e->shard = index;
+  e->older = e->newer = nullptr;
+  sh.map.emplace(e->view(), e);
+  sh.bytes += e->text.size();
+  misses.fetch_add(1, std::memory_order_relaxed);
+  return e;
+}
+
+void string_pool::release(const entry *held) {
+  entry *e = const_cast<entry *>(held);
+  shard &sh = shards[e->shard];
+  std::lock_guard<std::mutex> lock(sh.lock);
+  if (--e->refs) {
+    return;
+  }
+  // newest idle last: eviction takes the longest unused first.
+  e->older = sh.newest_idle;
+  (sh.newest_idle ? sh.newest_idle->newer : sh.oldest_idle) = e;
+  sh.newest_idle = e;
+  sh.idle_bytes += e->text.size();
+  evict_locked(sh);
+}
+
+size_t string_pool::bytes() const {
+  size_t total = 0;
+  for (size_t i = 0; i < shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].lock);
+    total += shards[i].bytes;
+  }
+  return total;
+}
+
+size_t string_pool::idle_bytes() const {
+  size_t total = 0;
+  for (size_t i = 0; i < shard_count; ++i) {
+    std::lock_guard<std::mutex> lock(shards[i].lock);
+    total += shards[i].idle_bytes;
+  }
+  return total;
+}
+
+string_pool::~string_pool() {
+  for (size_t i = 0; i < shard_count; ++i) {
+    for (auto &x: shards[i].map) {
+      delete x.second;
+    }
+  }
+}
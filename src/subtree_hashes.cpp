@@ -0,0 +1,237 @@
+#include <cstring>
+#include <unordered_set>
+#include "include/subtree_hashes.hpp"
+
+/**
+ * @brief finalizer of splitmix64: a bijective mix of 64 bits.
+ * @param x value to mix
+ * @returns mixed value
+ */
+static inline uint64_t mix_bits(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/**
+ * @brief hash a string eight bytes at a time. Unlike std::hash, the result
+ * does not depend on the standard library, so hashes can be stored.
+ * @param s bytes to hash
+ * @param seed hash of what precedes s
+ * @returns hash
+ */
+static uint64_t hash_bytes(const std::string_view s, const uint64_t seed) {
+  uint64_t h = seed ^ (s.size() * 0x9e3779b97f4a7c15ULL);
+  size_t i = 0;
+  for (; i + 8 <= s.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, s.data() + i, 8);
+    h = mix_bits(h ^ word);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, s.data() + i, s.size() - i);
+  return mix_bits(h ^ tail);
+}
+
+/**
+ * @brief check whether two nodes can be compared as versions of each other.
+ * @param a node
+ * @param b node
+ * @returns true if both are of the same kind and tag
+ */
+static inline bool same_kind(const dom_element *a, const dom_element *b) {
+  return a->is_a_text_node() == b->is_a_text_node() && a->is_a_comment() == b->is_a_comment() &&
+    a->tag_name() == b->tag_name();
+}
+
+uint64_t subtree_hashes::own_hash(const dom_element *x) {
+  const uint64_t kind = x->is_text_node ? 1 : x->is_comment ? 2 : !x->parent ? 3 : 4;
+  uint64_t h = hash_bytes(x->tag, kind);
+  h = hash_bytes(x->innertext, h);
+  // a sum does not depend on the order of the map.
+  uint64_t attributes = 0;
+  for (auto &a: x->attr) {
+    attributes += hash_bytes(a.second, hash_bytes(a.first, 5));
+  }
+  return mix_bits(h ^ attributes ^ (x->is_non_terminating << 0) ^ (x->space_before << 1) ^ (x->space_after << 2));
+}
+
+/**
+ * @brief add the hash of a child subtree to its parent's.
+ * @param hash hash of the parent so far
+ * @param child hash of the child subtree
+ * @returns hash
+ */
+static inline uint64_t add_child(const uint64_t hash, const uint64_t child) {
+  return mix_bits(hash * 0x9e3779b97f4a7c15ULL + child);
+}
+
+const subtree_hashes::entry &subtree_hashes::compute(const dom_element *root) {
+  auto found = table.find(root);
+  if (found != table.end()) {
+    return found->second;
+  }
+  // an empty table holds no child: skip their lookups on a first hash.
+  const bool fresh = table.empty();
+  // the document order positions bound the subtree size: no rehash while filling.
+  table.reserve(table.size() + (root->order_end - root->order_begin));
+  // post-order, each child folded into its parent's entry when done.
+  struct frame {
+    const dom_element *node;
+    size_t next;
+    entry e;
+  };
+  std::vector<frame> stack;
+  stack.push_back({ root, 0, { own_hash(root), 1 } });
+  while (true) {
+    frame &top = stack.back();
+    if (top.next < top.node->child_nodes.size()) {
+      const dom_element *child = top.node->child_nodes[top.next++];
+      auto hashed = fresh ? table.end() : table.find(child);
+      if (hashed != table.end()) {
+        top.e.hash = add_child(top.e.hash, hashed->second.hash);
+        top.e.nodes += hashed->second.nodes;
+      } else {
+        stack.push_back({ child, 0, { own_hash(child), 1 } });
+      }
+      continue;
+    }
+    const dom_element *x = top.node;
+    const entry e = top.e;
+    stack.pop_back();
+    if (stack.empty()) {
+      return table.emplace(x, e).first->second;
+    }
+    table.emplace(x, e);
+    stack.back().e.hash = add_child(stack.back().e.hash, e.hash);
+    stack.back().e.nodes += e.nodes;
+  }
+}
+
+void subtree_hashes::diff_into(const dom_element *a, const dom_element *b, std::vector<tree_change> &changes) const {
+  if (stored(a).hash == stored(b).hash) {
+    return;
+  }
+  if (own_hash(a) != own_hash(b)) {
+    changes.push_back({ change_kind::modified, a, b });
+  }
+  const std::vector<dom_element *> &x = a->child_nodes, &y = b->child_nodes;
+  size_t i = 0, j = 0, m = x.size(), n = y.size();
+  // most children are unchanged: skip the common ends first.
+  while (i < m && j < n && stored(x[i]).hash == stored(y[j]).hash) ++i, ++j;
+  while (m > i && n > j && stored(x[m - 1]).hash == stored(y[n - 1]).hash) --m, --n;
+  std::unordered_map<uint64_t, uint32_t> left, right;   /// hashes not aligned yet, on each side
+  if (i < m && j < n) {
+    for (size_t k = i; k < m; ++k) ++left[stored(x[k]).hash];
+    for (size_t k = j; k < n; ++k) ++right[stored(y[k]).hash];
+  }
+  while (i < m && j < n) {
+    const uint64_t hx = stored(x[i]).hash, hy = stored(y[j]).hash;
+    if (hx == hy) {
+      --left[hx];
+      --right[hy];
+      ++i, ++j;
+    } else if (left[hy] > 0 && right[hx] == 0) {
+      // y[j] comes later on the old side: x[i] went away.
+      --left[hx];
+      changes.push_back({ change_kind::removed, x[i++], nullptr });
+    } else if (right[hx] > 0) {
+      --right[hy];
+      changes.push_back({ change_kind::inserted, nullptr, y[j++] });
+    } else if (same_kind(x[i], y[j])) {
+      // neither appears on the other side: the same node, changed.
+      --left[hx];
+      --right[hy];
+      diff_into(x[i++], y[j++], changes);
+    } else {
+      --left[hx];
+      --right[hy];
+      changes.push_back({ change_kind::removed, x[i++], nullptr });
+      changes.push_back({ change_kind::inserted, nullptr, y[j++] });
+    }
+  }
+  for (; i < m; ++i) changes.push_back({ change_kind::removed, x[i], nullptr });
+  for (; j < n; ++j) changes.push_back({ change_kind::inserted, nullptr, y[j] });
+}
+
+std::vector<subtree_hashes::tree_change> subtree_hashes::diff(const dom_element *before, const dom_element *after) {
+  std::vector<tree_change> changes;
+  compute(before);
+  compute(after);
+  if (!same_kind(before, after)) {
+    changes.push_back({ change_kind::removed, before, nullptr });
+    changes.push_back({ change_kind::inserted, nullptr, after });
+  } else {
+    diff_into(before, after, changes);
+  }
+  return changes;
+}
+
+std::vector<uint64_t> subtree_hashes::boilerplate(const std::vector<const dom_element *> &documents,
+  const size_t min_documents, const uint32_t min_nodes) {
+  // number of documents each large enough subtree appears in.
+  std::unordered_map<uint64_t, size_t> seen_in;
+  std::unordered_set<uint64_t> in_document;
+  std::vector<const dom_element *> stack;
+  for (auto &document: documents) {
+    compute(document);
+    in_document.clear();
+    stack.assign(1, document);
+    while (stack.size()) {
+      const dom_element *x = stack.back();
+      stack.pop_back();
+      const entry &e = stored(x);
+      if (e.nodes < min_nodes) continue;
+      if (in_document.insert(e.hash).second) ++seen_in[e.hash];
+      stack.insert(stack.end(), x->children.rbegin(), x->children.rend());
+    }
+  }
+  // report the outermost ones: the inside of a repeated subtree repeats too.
+  std::vector<uint64_t> hashes;
+  std::unordered_set<uint64_t> reported;
+  for (auto &document: documents) {
+    stack.assign(1, document);
+    while (stack.size()) {
+      const dom_element *x = stack.back();
+      stack.pop_back();
+      const entry &e = stored(x);
+      if (e.nodes < min_nodes) continue;
+      if (seen_in[e.hash] >= min_documents) {
+        if (reported.insert(e.hash).second) hashes.push_back(e.hash);
+        continue;
+      }
+      stack.insert(stack.end(), x->children.rbegin(), x->children.rend());
+    }
+  }
+  return hashes;
+}
+
+void subtree_hashes::invalidate(const dom_element *node) {
+  for (; node; node = node->parent) {
+    table.erase(node);
+  }
+}
+
+void subtree_hashes::forget(const dom_element *root) {
+  if (table.empty()) {
+    return;
+  }
+  std::vector<const dom_element *> stack(1, root);
+  while (stack.size()) {
+    const dom_element *x = stack.back();
+    stack.pop_back();
+    table.erase(x);
+    stack.insert(stack.end(), x->child_nodes.begin(), x->child_nodes.end());
+  }
+}
+
+void subtree_hashes::memory_report(memory_category &category) const {
+  // a node holds the next pointer, the key/value pair and the cached hash.
+  category.used += table.size() * (sizeof(void *) + sizeof(std::pair<const dom_element *const, entry>) + sizeof(size_t));
+  category.used += table.size() * sizeof(void *);
+  if (table.bucket_count() > table.size()) {
+    category.slack += (table.bucket_count() - table.size()) * sizeof(void *);
+  }
+}
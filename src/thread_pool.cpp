@@ -0,0 +1,61 @@
+#include "include/thread_pool.hpp"
+
+thread_pool::thread_pool(size_t threads):
+  job(nullptr), job_size(0), next(0), generation(0), busy(0), stopping(false) {
+  // hardware_concurrency() may be 0, which wraps around.
+  if (threads > 1024) threads = 0;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([this]() {
+      size_t seen = 0;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> guard(lock);
+          start_cv.wait(guard, [&]() { return stopping || generation != seen; });
+          if (stopping) return;
+          seen = generation;
+        }
+        drain();
+        std::lock_guard<std::mutex> guard(lock);
+        if (--busy == 0) done_cv.notify_one();
+      }
+    });
+  }
+}
+
+void thread_pool::drain() {
+  size_t i;
+  while ((i = next.fetch_add(1, std::memory_order_relaxed)) < job_size) {
+    (*job)(i);
+  }
+}
+
+void thread_pool::parallel_for(const size_t n, const std::function<void(size_t)> &fn) {
+  if (n == 0) return;
+  if (workers.empty() || n == 1) {
+    for (size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+  std::lock_guard<std::mutex> serial(run_lock);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    job = &fn;
+    job_size = n;
+    next.store(0, std::memory_order_relaxed);
+    busy = workers.size();
+    ++generation;
+  }
+  start_cv.notify_all();
+  drain();
+  std::unique_lock<std::mutex> guard(lock);
+  done_cv.wait(guard, [&]() { return busy == 0; });
+  job = nullptr;
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  start_cv.notify_all();
+  for (auto &x: workers) x.join();
+}
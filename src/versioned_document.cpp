@@ -0,0 +1,365 @@
+#include <thread>
+#include "include/versioned_document.hpp"
+
+static inline bool is_a_whitespace(const char c) { return c == ' ' || c == '\n' || c == '\t'; }
+
+const std::string *versioned_document::node::find_attribute(const std::string &attribute_name) const {
+  for (auto &x: attr) {
+    if (x.first == attribute_name) return &x.second;
+  }
+  return nullptr;
+}
+
+std::string versioned_document::node::get_attribute_value(const std::string &attribute_name) const {
+  const std::string *value = find_attribute(attribute_name);
+  return value ? *value : "";
+}
+
+std::string versioned_document::node::innerText() const {
+  if (is_text_node) {
+    return text;
+  }
+  std::string value = "";
+  for (const auto &x: child_nodes) {
+    value += x->innerText();
+  }
+  return value;
+}
+
+std::string versioned_document::node::innerHTML() const {
+  std::string output = "";
+  construct_innerHTML(output);
+  return output;
+}
+
+void versioned_document::node::construct_innerHTML(std::string &buffop) const {
+  if (is_document) {
+    for (auto &x: child_nodes) {
+      x->construct_innerHTML(buffop);
+    }
+    return;
+  }
+  if (is_comment) {
+    if (text != "DOCTYPE html" && text != "doctype html") {
+      buffop += "<!--";
+      buffop += text;
+      buffop += "-->";
+    } else {
+      buffop += "<!";
+      buffop += text;
+      buffop += ">";
+    }
+    return;
+  }
+  if (is_text_node) {
+    buffop += text;
+    return;
+  }
+  buffop.push_back('<');
+  buffop += tag;
+  for (auto &x: attr) {
+    buffop.push_back(' ');
+    buffop += x.first;
+    buffop += "=\"";
+    buffop += x.second;
+    buffop.push_back('"');
+  }
+  if (is_non_terminating) {
+    buffop += " />";
+    return;
+  }
+  buffop.push_back('>');
+  for (auto &x: child_nodes) {
+    x->construct_innerHTML(buffop);
+  }
+  buffop += "</";
+  buffop += tag;
+  buffop.push_back('>');
+}
+
+versioned_document::node *versioned_document::space_node() {
+  node *x = new node();
+  x->text = " ";
+  x->is_text_node = true;
+  x->is_comment = x->is_non_terminating = x->is_document = false;
+  return x;
+}
+
+versioned_document::node *versioned_document::copy_tree(const dom_element *dom) {
+  node *x = new node();
+  x->tag = dom->tag;
+  x->text = dom->innertext;
+  x->id = dom->id;
+  x->class_list = dom->class_list;
+  x->attr.assign(dom->attr.begin(), dom->attr.end());
+  x->is_text_node = dom->is_text_node;
+  x->is_comment = dom->is_comment;
+  x->is_non_terminating = dom->is_non_terminating;
+  x->is_document = !dom->parent;
+  x->child_nodes.reserve(dom->child_nodes.size());
+  for (auto &child: dom->child_nodes) {
+    // whitespace dropped by the parser comes back as a one-space text node.
+    if (child->space_before) x->child_nodes.push_back(space_node());
+    x->child_nodes.push_back(copy_tree(child));
+    if (child->space_after) x->child_nodes.push_back(space_node());
+  }
+  return x;
+}
+
+void versioned_document::free_tree(const node *x) {
+  for (auto &child: x->child_nodes) {
+    free_tree(child);
+  }
+  delete x;
+}
+
+void versioned_document::retire_tree(const node *x, std::vector<const node *> &nodes) {
+  nodes.push_back(x);
+  for (auto &child: x->child_nodes) {
+    retire_tree(child, nodes);
+  }
+}
+
+bool versioned_document::changes_fields(const edit &e, const node &x) {
+  const std::string *value = x.find_attribute(*e.name);
+  if (e.kind == edit_kind::set_attribute) {
+    return !value || *value != *e.value;
+  }
+  return value;
+}
+
+void versioned_document::apply_to_fields(const edit &e, node *x) {
+  const std::string &name = *e.name;
+  size_t i = 0;
+  while (i < x->attr.size() && x->attr[i].first != name) ++i;
+  if (e.kind == edit_kind::set_attribute) {
+    if (i == x->attr.size()) {
+      x->attr.emplace_back(name, *e.value);
+    } else {
+      x->attr[i].second = *e.value;
+    }
+  } else if (i < x->attr.size()) {
+    x->attr.erase(x->attr.begin() + i);
+  }
+  const std::string empty;
+  const std::string &value = e.kind == edit_kind::set_attribute ? *e.value : empty;
+  if (name == "id") {
+    x->id = value;
+  } else if (name == "class") {
+    x->class_list.clear();
+    size_t j = 0;
+    while (j < value.size()) {
+      while (j < value.size() && is_a_whitespace(value[j])) ++j;
+      const size_t begin = j;
+      while (j < value.size() && !is_a_whitespace(value[j])) ++j;
+      if (j > begin) x->class_list.emplace_back(value, begin, j - begin);
+    }
+  }
+}
+
+const versioned_document::node *versioned_document::rewrite(const edit &e, const node *x, const bool matchable,
+  size_t &changed, std::vector<const node *> &unlinked) {
+  node *copy = nullptr;
+  if (matchable && e.kind != edit_kind::remove_element && (*e.match)(*x) && changes_fields(e, *x)) {
+    copy = new node(*x);
+    apply_to_fields(e, copy);
+    ++changed;
+  }
+  // children are written back in place, removed ones leaving no gap.
+  size_t kept = 0;
+  for (size_t i = 0; i < x->child_nodes.size(); ++i) {
+    const node *child = x->child_nodes[i];
+    const node *result = child;
+    if (!child->is_text_node) {
+      if (e.kind == edit_kind::remove_element && (*e.match)(*child)) {
+        retire_tree(child, unlinked);
+        result = nullptr;
+        ++changed;
+      } else {
+        result = rewrite(e, child, true, changed, unlinked);
+      }
+    }
+    if (result != child && !copy) {
+      // first change below x: copy it, the rest of the path follows.
+      copy = new node(*x);
+    }
+    if (!copy) {
+      ++kept;
+    } else if (result) {
+      copy->child_nodes[kept++] = result;
+    }
+  }
+  if (!copy) {
+    return x;
+  }
+  copy->child_nodes.resize(kept);
+  unlinked.push_back(x);
+  return copy;
+}
+
+size_t versioned_document::commit(const edit &e) {
+  std::lock_guard<std::mutex> lock(writer);
+  const version_record *old = current.load();
+  size_t changed = 0;
+  std::vector<const node *> unlinked;
+  const node *root = rewrite(e, old->root, false, changed, unlinked);
+  if (root == old->root) {
+    return changed;
+  }
+  // a reader that pins the new version then reads its number in version() too.
+  current_number.store(old->number + 1, std::memory_order_release);
+  current.store(new version_record{ root, old->number + 1 });
+  // a reader that still got the old version pinned an epoch before this one.
+  const uint64_t epoch = global_epoch.fetch_add(1) + 1;
+  retired.push_back(retired_batch{ epoch, old, std::move(unlinked) });
+  reclaim_locked();
+  return changed;
+}
+
+void versioned_document::reclaim_locked() {
+  uint64_t oldest = UINT64_MAX;
+  for (size_t i = 0; i < slot_count; ++i) {
+    const uint64_t epoch = slots[i].epoch.load();
+    if (epoch && epoch < oldest) oldest = epoch;
+  }
+  // batches are in epoch order.
+  size_t freed = 0;
+  while (freed < retired.size() && retired[freed].epoch <= oldest) {
+    for (auto &x: retired[freed].nodes) {
+      delete x;
+    }
+    delete retired[freed].record;
+    ++freed;
+  }
+  retired.erase(retired.begin(), retired.begin() + freed);
+}
+
+versioned_document::versioned_document(const dom_element *root, const size_t max_readers):
+  current_number(0), global_epoch(1), slots(new reader_slot[max_readers ? max_readers : 1]), slot_count(max_readers ? max_readers : 1) {
+  for (size_t i = 0; i < slot_count; ++i) {
+    slots[i].epoch.store(0, std::memory_order_relaxed);
+  }
+  current.store(new version_record{ copy_tree(root), 0 });
+}
+
+versioned_document::snapshot versioned_document::pin() {
+  // start where this thread probably found a free slot last time.
+  size_t i = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+  while (true) {
+    for (size_t n = 0; n < slot_count; ++n) {
+      uint64_t expected = 0;
+      if (!slots[i].epoch.load(std::memory_order_relaxed) &&
+        slots[i].epoch.compare_exchange_strong(expected, global_epoch.load())) {
+        // the version is read after the pin is visible, see commit().
+        return snapshot(&slots[i], current.load());
+      }
+      i = i + 1 == slot_count ? 0 : i + 1;
+    }
+    std::this_thread::yield();
+  }
+}
+
+versioned_document::snapshot &versioned_document::snapshot::operator=(snapshot &&other) {
+  if (this != &other) {
+    if (slot) slot->epoch.store(0, std::memory_order_release);
+    slot = other.slot;
+    record = other.record;
+    other.slot = nullptr;
+  }
+  return *this;
+}
+
+versioned_document::snapshot::~snapshot() {
+  if (slot) slot->epoch.store(0, std::memory_order_release);
+}
+
+/**
+ * @brief pre-order walk over the elements below a node.
+ * @param x node to search below
+ * @param visit called per element, returns true to stop descending below it
+ * @returns void
+ */
+template <typename visit_type>
+static void walk(const versioned_document::node *x, const visit_type &visit) {
+  for (auto &child: x->get_child_nodes()) {
+    if (child->is_a_text_node()) continue;
+    if (!visit(child)) walk(child, visit);
+  }
+}
+
+const versioned_document::node *versioned_document::snapshot::get_element_by_id(const std::string &id) const {
+  const node *found = nullptr;
+  walk(record->root, [&](const node *x) {
+    if (!found && x->get_id() == id) found = x;
+    return found != nullptr;
+  });
+  return found;
+}
+
+std::vector<const versioned_document::node *> versioned_document::snapshot::get_elements_by_tag_name(
+  const std::string &tagname) const {
+  std::vector<const node *> dom;
+  walk(record->root, [&](const node *x) {
+    if (x->tag_name() == tagname) dom.push_back(x);
+    return false;
+  });
+  return dom;
+}
+
+std::vector<const versioned_document::node *> versioned_document::snapshot::get_elements_by_class_name(
+  const std::string &classname) const {
+  std::vector<const node *> dom;
+  walk(record->root, [&](const node *x) {
+    if (!x->has_classname(classname)) return false;
+    dom.push_back(x);
+    return true;
+  });
+  return dom;
+}
+
+std::vector<const versioned_document::node *> versioned_document::snapshot::get_elements_if(
+  const std::function<bool(const node &)> &predicate) const {
+  std::vector<const node *> dom;
+  walk(record->root, [&](const node *x) {
+    if (predicate(*x)) dom.push_back(x);
+    return false;
+  });
+  return dom;
+}
+
+size_t versioned_document::remove_elements_if(const std::function<bool(const node &)> &match) {
+  return commit(edit{ edit_kind::remove_element, &match, nullptr, nullptr });
+}
+
+bool versioned_document::remove_node(const node *x) {
+  const std::function<bool(const node &)> match = [x](const node &y) { return &y == x; };
+  return commit(edit{ edit_kind::remove_element, &match, nullptr, nullptr }) > 0;
+}
+
+size_t versioned_document::set_attribute_if(const std::function<bool(const node &)> &match,
+  const std::string &attribute_name, const std::string &value) {
+  return commit(edit{ edit_kind::set_attribute, &match, &attribute_name, &value });
+}
+
+size_t versioned_document::remove_attribute_if(const std::function<bool(const node &)> &match,
+  const std::string &attribute_name) {
+  return commit(edit{ edit_kind::remove_attribute, &match, &attribute_name, nullptr });
+}
+
+size_t versioned_document::reclaim() {
+  std::lock_guard<std::mutex> lock(writer);
+  reclaim_locked();
+  return retired.size();
+}
+
+versioned_document::~versioned_document() {
+  for (auto &batch: retired) {
+    for (auto &x: batch.nodes) {
+      delete x;
+    }
+    delete batch.record;
+  }
+  const version_record *record = current.load();
+  free_tree(record->root);
+  delete record;
+}
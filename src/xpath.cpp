@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstring>
+#include "include/xpath.hpp"
+
+static inline bool is_alpha(const char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+static inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+static inline bool is_name_char(const char c) {
+  return is_alpha(c) || is_digit(c) || c == '-' || c == '_' || c == ':' || c == '.';
+}
+static inline char char_to_lowercase(const char c) { return is_alpha(c) ? (c | 32) : c; }
+
+static inline void skip_whitespaces(const std::string &expression, size_t &i) {
+  while (i < expression.size() && (expression[i] == ' ' || expression[i] == '\t' || expression[i] == '\n')) ++i;
+}
+
+/**
+ * @brief consume a keyword if the expression continues with it.
+ * @param expression text of the expression
+ * @param i position, advanced past the keyword if it matches
+ * @param keyword text to match
+ * @returns true if the keyword was consumed
+ */
+static bool consume(const std::string &expression, size_t &i, const char *keyword) {
+  skip_whitespaces(expression, i);
+  const size_t length = strlen(keyword);
+  if (expression.compare(i, length, keyword) != 0) return false;
+  i += length;
+  return true;
+}
+
+static std::string read_name(const std::string &expression, size_t &i) {
+  std::string name;
+  skip_whitespaces(expression, i);
+  while (i < expression.size() && is_name_char(expression[i])) name.push_back(char_to_lowercase(expression[i++]));
+  return name;
+}
+
+static bool read_number(const std::string &expression, size_t &i, int64_t &number) {
+  skip_whitespaces(expression, i);
+  if (i == expression.size() || !is_digit(expression[i])) return false;
+  number = 0;
+  while (i < expression.size() && is_digit(expression[i])) number = number * 10 + (expression[i++] - '0');
+  return true;
+}
+
+static bool read_literal(const std::string &expression, size_t &i, std::string &value) {
+  skip_whitespaces(expression, i);
+  if (i == expression.size() || (expression[i] != '\'' && expression[i] != '"')) return false;
+  const size_t end = expression.find(expression[i], i + 1);
+  if (end == std::string::npos) return false;
+  value = expression.substr(i + 1, end - i - 1);
+  i = end + 1;
+  return true;
+}
+
+bool xpath::fail(const std::string &what, const size_t i) {
+  error_message = what + " at position " + std::to_string(i);
+  steps.clear();
+  return false;
+}
+
+xpath::xpath(const std::string &expression): absolute(false) {
+  size_t i = 0;
+  skip_whitespaces(expression, i);
+  if (i == expression.size()) {
+    fail("empty expression", i);
+    return;
+  }
+  axis next = axis::child;
+  if (expression[i] == '/') {
+    absolute = true;
+    if (i + 1 < expression.size() && expression[i + 1] == '/') {
+      next = axis::descendant;
+      i += 2;
+    } else {
+      ++i;
+      skip_whitespaces(expression, i);
+      // "/" alone selects the document.
+      if (i == expression.size()) return;
+    }
+  }
+  while (true) {
+    step s;
+    s.ax = next;
+    if (!parse_step(expression, i, s)) return;
+    steps.push_back(s);
+    skip_whitespaces(expression, i);
+    if (i == expression.size()) return;
+    if (expression[i] != '/') {
+      fail("expected '/'", i);
+      return;
+    }
+    if (s.test == node_test::attribute) {
+      fail("an attribute step must be the last step", i);
+      return;
+    }
+    if (i + 1 < expression.size() && expression[i + 1] == '/') {
+      next = axis::descendant;
+      i += 2;
+    } else {
+      next = axis::child;
+      ++i;
+    }
+  }
+}
+
+bool xpath::parse_step(const std::string &expression, size_t &i, step &s) {
+  s.positional = false;
+  skip_whitespaces(expression, i);
+  if (i < expression.size() && expression[i] == '@') {
+    ++i;
+    s.test = node_test::attribute;
+    if (!consume(expression, i, "*")) {
+      s.name = read_name(expression, i);
+      if (s.name.empty()) return fail("expected an attribute name", i);
+    }
+  } else if (i < expression.size() && expression[i] == '*') {
+    ++i;
+    s.test = node_test::any;
+  } else {
+    s.name = read_name(expression, i);
+    if (s.name.empty()) return fail("expected a node test", i);
+    s.test = node_test::name;
+    if (s.name == "text" && consume(expression, i, "(")) {
+      if (!consume(expression, i, ")")) return fail("expected ')'", i);
+      s.test = node_test::text;
+      s.name.clear();
+    }
+  }
+  while (consume(expression, i, "[")) {
+    if (s.test == node_test::attribute) return fail("predicates on attribute steps are not supported", i);
+    predicate p;
+    if (!parse_predicate(expression, i, p)) return false;
+    s.positional |= p.kind == predicate_kind::position;
+    s.predicates.push_back(p);
+  }
+  return true;
+}
+
+bool xpath::parse_predicate(const std::string &expression, size_t &i, predicate &p) {
+  p.op = compare::eq;
+  p.from_last = false;
+  p.number = 0;
+  if (read_number(expression, i, p.number)) {
+    p.kind = predicate_kind::position;
+  } else if (consume(expression, i, "position()")) {
+    p.kind = predicate_kind::position;
+    if (consume(expression, i, "!=")) p.op = compare::ne;
+    else if (consume(expression, i, "<=")) p.op = compare::le;
+    else if (consume(expression, i, ">=")) p.op = compare::ge;
+    else if (consume(expression, i, "<")) p.op = compare::lt;
+    else if (consume(expression, i, ">")) p.op = compare::gt;
+    else if (!consume(expression, i, "=")) return fail("expected a comparison", i);
+    if (!read_number(expression, i, p.number)) {
+      if (!consume(expression, i, "last()")) return fail("expected a number or last()", i);
+      p.from_last = true;
+      if (consume(expression, i, "-") && !read_number(expression, i, p.number)) return fail("expected a number", i);
+    }
+  } else if (consume(expression, i, "last()")) {
+    p.kind = predicate_kind::position;
+    p.from_last = true;
+    if (consume(expression, i, "-") && !read_number(expression, i, p.number)) return fail("expected a number", i);
+  } else if (consume(expression, i, "@")) {
+    p.name = read_name(expression, i);
+    if (p.name.empty()) return fail("expected an attribute name", i);
+    p.kind = predicate_kind::has_attribute;
+    if (consume(expression, i, "!=")) {
+      p.kind = predicate_kind::attribute_not_equals;
+    } else if (consume(expression, i, "=")) {
+      p.kind = predicate_kind::attribute_equals;
+    }
+    if (p.kind != predicate_kind::has_attribute && !read_literal(expression, i, p.value)) {
+      return fail("expected a string literal", i);
+    }
+  } else if (consume(expression, i, "contains(")) {
+    p.kind = predicate_kind::attribute_contains;
+    if (!consume(expression, i, "@")) return fail("expected an attribute", i);
+    p.name = read_name(expression, i);
+    if (p.name.empty()) return fail("expected an attribute name", i);
+    if (!consume(expression, i, ",")) return fail("expected ','", i);
+    if (!read_literal(expression, i, p.value)) return fail("expected a string literal", i);
+    if (!consume(expression, i, ")")) return fail("expected ')'", i);
+  } else {
+    return fail("unsupported predicate", i);
+  }
+  if (!consume(expression, i, "]")) return fail("expected ']'", i);
+  return true;
+}
+
+bool xpath::test_node(const step &s, const dom_element *x) {
+  if (x->is_text_node) return s.test == node_test::text;
+  if (x->is_comment) return false;
+  switch (s.test) {
+    case node_test::name:
+      return x->tag == s.name;
+    case node_test::any:
+      return true;
+    case node_test::attribute:
+      return s.name.empty() ? !x->attr.empty() : x->attr.find(s.name) != x->attr.end();
+    default:
+      return false;
+  }
+}
+
+bool xpath::test_predicate(const predicate &p, const dom_element *x, const size_t position, const size_t size) {
+  if (p.kind == predicate_kind::position) {
+    const int64_t target = p.from_last ? static_cast<int64_t>(size) - p.number : p.number;
+    const int64_t at = static_cast<int64_t>(position);
+    switch (p.op) {
+      case compare::eq: return at == target;
+      case compare::ne: return at != target;
+      case compare::lt: return at < target;
+      case compare::le: return at <= target;
+      case compare::gt: return at > target;
+      default: return at >= target;
+    }
+  }
+  if (p.kind == predicate_kind::attribute_equals && p.name == "id") {
+    // the id is kept out of the attribute map lookup; an empty id is also
+    // what an element without the attribute has.
+    return x->id == p.value && (p.value.size() || x->attr.count("id"));
+  }
+  const auto found = x->attr.find(p.name);
+  switch (p.kind) {
+    case predicate_kind::has_attribute:
+      return found != x->attr.end();
+    case predicate_kind::attribute_equals:
+      return found != x->attr.end() && found->second == p.value;
+    case predicate_kind::attribute_not_equals:
+      // XPath: false when the attribute is missing.
+      return found != x->attr.end() && found->second != p.value;
+    default:
+      return found != x->attr.end() && found->second.find(p.value) != std::string::npos;
+  }
+}
+
+void xpath::select_children(const step &s, const dom_element *parent, std::vector<const dom_element *> &kept) {
+  const std::vector<dom_element *> &list = s.test == node_test::text ? parent->child_nodes : parent->children;
+  const size_t begin = kept.size();
+  for (auto &x: list) {
+    if (test_node(s, x)) kept.push_back(x);
+  }
+  // each predicate filters the result of the previous one, positions are
+  // counted in what is left.
+  for (auto &p: s.predicates) {
+    const size_t size = kept.size() - begin;
+    size_t j = begin;
+    for (size_t k = begin; k < kept.size(); ++k) {
+      if (test_predicate(p, kept[k], k - begin + 1, size)) kept[j++] = kept[k];
+    }
+    kept.resize(j);
+  }
+}
+
+void xpath::expand(const step &s, const dom_element *parent, const bool recursive,
+  const std::vector<const dom_element *> *members, std::vector<const dom_element *> &out) {
+  const bool apply = !members || std::binary_search(members->begin(), members->end(), parent);
+  if (!recursive && !members) {
+    select_children(s, parent, out);
+    return;
+  }
+  const std::vector<dom_element *> &list = s.test == node_test::text ? parent->child_nodes : parent->children;
+  if (!s.positional) {
+    for (auto &x: list) {
+      if (apply && test_node(s, x)) {
+        bool keep = true;
+        for (auto &p: s.predicates) keep = keep && test_predicate(p, x, 0, 0);
+        if (keep) out.push_back(x);
+      }
+      if (!x->is_text_node) expand(s, x, recursive, members, out);
+    }
+    return;
+  }
+  std::vector<const dom_element *> kept;
+  if (apply) select_children(s, parent, kept);
+  size_t k = 0;
+  for (auto &x: list) {
+    if (k < kept.size() && kept[k] == x) {
+      out.push_back(x);
+      ++k;
+    }
+    if (!x->is_text_node) expand(s, x, recursive, members, out);
+  }
+}
+
+std::vector<const dom_element *> xpath::evaluate(const dom_element *context) const {
+  const dom_element *node = context;
+  if (absolute) {
+    while (node->parent) node = node->parent;
+  }
+  std::vector<const dom_element *> set(1, node), next, tops, members;
+  if (!valid()) set.clear();
+  for (auto &s: steps) {
+    // the set is in document order: keep the nodes that are not inside a
+    // previous one, the others are reached again from their ancestor.
+    tops.clear();
+    for (auto &x: set) {
+      if (tops.empty() || !tops.back()->contains(x)) tops.push_back(x);
+    }
+    next.clear();
+    if (s.test == node_test::attribute) {
+      if (s.ax == axis::child) {
+        for (auto &x: set) {
+          if (test_node(s, x)) next.push_back(x);
+        }
+      } else {
+        for (auto &x: tops) {
+          if (test_node(s, x)) next.push_back(x);
+          expand(s, x, true, nullptr, next);
+        }
+      }
+    } else if (s.ax == axis::descendant) {
+      for (auto &x: tops) expand(s, x, true, nullptr, next);
+    } else if (tops.size() == set.size()) {
+      for (auto &x: set) expand(s, x, false, nullptr, next);
+    } else {
+      // children of nested nodes interleave: walk the subtrees in document order.
+      members = set;
+      std::sort(members.begin(), members.end());
+      for (auto &x: tops) expand(s, x, false, &members, next);
+    }
+    set.swap(next);
+  }
+  return set;
+}
+
+std::vector<dom_element *> xpath::select(const dom_element *context) const {
+  const std::vector<const dom_element *> nodes = evaluate(context);
+  std::vector<dom_element *> dom;
+  dom.reserve(nodes.size());
+  for (auto &x: nodes) dom.push_back(const_cast<dom_element *>(x));
+  return dom;
+}
+
+std::vector<std::string> xpath::select_strings(const dom_element *context) const {
+  const std::vector<const dom_element *> nodes = evaluate(context);
+  std::vector<std::string> values;
+  const bool attribute = steps.size() && steps.back().test == node_test::attribute;
+  for (auto &x: nodes) {
+    if (attribute) {
+      const std::string &name = steps.back().name;
+      if (name.empty()) {
+        for (auto &a: x->attr) values.push_back(a.second);
+      } else {
+        values.push_back(x->attr.find(name)->second);
+      }
+    } else if (x->is_text_node) {
+      values.push_back(x->innertext);
+    } else {
+      values.push_back(x->innerText());
+    }
+  }
+  return values;
+}
@@ -0,0 +1,21 @@
+#ifndef __CHECK_HPP_H_
+#define __CHECK_HPP_H_
+
+#include <iostream>
+
+/// number of failed checks of the test
+static int failures = 0;
+
+/**
+ * @brief report a failed condition and go on, so that one run shows every
+ * failure. A test returns failures from main.
+ */
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition "\n"; \
+      ++failures; \
+    } \
+  } while (0)
+
+#endif
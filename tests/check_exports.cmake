@@ -0,0 +1,26 @@
+# Fails unless every symbol the shared library defines is part of the C
+# interface. Run with -DNM=<nm> -DLIBRARY=<libhtml_parser.so>.
+execute_process(COMMAND ${NM} -D --defined-only ${LIBRARY} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "${NM} failed on ${LIBRARY}")
+endif()
+string(REPLACE "\n" ";" symbols "${symbols}")
+set(exported 0)
+foreach(line ${symbols})
+  # "<address> <type> <name>[@@version]"; the version node itself is absolute.
+  if (line MATCHES "^[0-9a-fA-F]* *([A-Za-z]) ([^@]+)")
+    set(type ${CMAKE_MATCH_1})
+    set(name ${CMAKE_MATCH_2})
+    if (type STREQUAL "A")
+      continue()
+    endif()
+    if (NOT name MATCHES "^hp_")
+      message(FATAL_ERROR "exported symbol outside the C interface: ${name}")
+    endif()
+    math(EXPR exported "${exported} + 1")
+  endif()
+endforeach()
+if (exported EQUAL 0)
+  message(FATAL_ERROR "no hp_ symbol exported by ${LIBRARY}")
+endif()
+message(STATUS "${exported} hp_ symbols exported")
@@ -0,0 +1,101 @@
+#include <string>
+#include <vector>
+#include "html_parser.hpp"
+#include "check.hpp"
+
+/**
+ * @brief compare the spans of two documents element by element, and check
+ * that each span starts with the tag in the source.
+ * @param edited document updated by apply_edit
+ * @param parsed document parsed from scratch from the same source
+ * @param source source of both
+ * @returns void
+ */
+static void check_spans(const dom_element *edited, const dom_element *parsed, const std::string &source) {
+  CHECK(edited->tag_name() == parsed->tag_name());
+  CHECK(edited->get_source_offset() == parsed->get_source_offset());
+  CHECK(edited->get_source_length() == parsed->get_source_length());
+  if (edited->get_source_length() && !edited->is_a_comment()) {
+    CHECK(source.compare(edited->get_source_offset(), edited->tag_name().size() + 1, "<" + edited->tag_name()) == 0);
+  }
+  const std::vector<dom_element *> &a = edited->get_children(), &b = parsed->get_children();
+  CHECK(a.size() == b.size());
+  for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+    check_spans(a[i], b[i], source);
+  }
+}
+
+/**
+ * @brief check the document order positions after an edit against a walk
+ * of the tree: apply_edit gives them again.
+ * @param document root
+ * @returns void
+ */
+static void check_order(const dom_element *document) {
+  std::vector<const dom_element *> order, stack(1, document);
+  while (stack.size()) {
+    const dom_element *x = stack.back();
+    stack.pop_back();
+    order.push_back(x);
+    stack.insert(stack.end(), x->get_child_nodes().rbegin(), x->get_child_nodes().rend());
+  }
+  for (size_t i = 1; i < order.size(); ++i) {
+    CHECK(dom_element::document_order(order[i - 1], order[i]));
+    CHECK(document->contains(order[i]));
+    CHECK(order[i]->get_parent()->contains(order[i]) && !order[i]->contains(order[i]->get_parent()));
+  }
+}
+
+int main() {
+  const std::string source =
+    "<html><head><title>t</title></head><body>"
+    "<div id=\"a\"><p>one <b>two</b></p><p>three</p></div>"
+    "<ul><li>x</li><li>y</li></ul>"
+    "<div id=\"b\"><span>z</span></div>"
+    "</body></html>";
+  html_parser parser;
+  dom_element *document = parser.parse_html_editable(source);
+  CHECK(document != nullptr);
+
+  struct edit {
+    std::string at;         /// text the edit starts at
+    uint64_t removed;
+    std::string inserted;
+  };
+  // each edit moves the elements after it, so later spans only stay right
+  // if the relative offsets of every enclosing element are repaired.
+  const std::vector<edit> edits = {
+    { "two", 3, "two and a half" },
+    { "three", 0, "<i>new</i> " },
+    { "<li>y", 0, "<li>w</li>" },
+    { "x</li>", 1, "" },
+    { "<span>", 6, "<em>" },
+    { "</span>", 7, "</em>" },
+    { "<p><i>new", 0, "<section><p>s</p></section>" },
+    { "new", 3, "newer" },
+    // a comment left open escapes its element: the whole source is reparsed.
+    { "one", 3, "<!-- open" },
+    { "z", 1, "-->" },
+  };
+  for (auto &e: edits) {
+    const size_t offset = parser.source().find(e.at);
+    CHECK(offset != std::string::npos);
+    if (offset == std::string::npos) continue;
+    dom_element *target = parser.apply_edit(offset, e.removed, e.inserted);
+    CHECK(target != nullptr);
+    if (!target) continue;
+    if (e.at == "new") {
+      // an edit inside one element only reparses that element.
+      CHECK(target->tag_name() == "i");
+    }
+    // a full reparse returns the new document.
+    if (!target->get_parent()) document = target;
+    html_parser reference;
+    const dom_element *parsed = reference.parse_html_editable(parser.source());
+    CHECK(document->innerHTML() == parsed->innerHTML());
+    check_spans(document, parsed, parser.source());
+    check_order(document);
+  }
+  CHECK(parser.apply_edit(parser.source().size() + 1, 0, "x") == nullptr);
+  return failures;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "html_parser_c.h"
+
+/* number of failed checks of the test */
+static int failures = 0;
+
+/* report a failed condition and go on, as CHECK in check.hpp. */
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+      ++failures; \
+    } \
+  } while (0)
+
+/**
+ * @brief run the queries of the interface on a parsed page.
+ * @param root root of the page
+ * @returns void
+ */
+static void check_queries(const hp_node *root) {
+  const hp_node *links[4];
+  const hp_node *list, *link;
+  const char *text;
+  size_t length = 0;
+  char *html;
+
+  CHECK(hp_get_elements_by_tag_name(root, "a", NULL, 0) == 3);
+  CHECK(hp_get_elements_by_tag_name(root, "a", links, 2) == 3);
+  CHECK(strcmp(hp_node_tag(links[1]), "a") == 0);
+  CHECK(strcmp(hp_node_attribute(links[1], "href", &length), "/one") == 0 && length == 4);
+  CHECK(hp_node_attribute(links[0], "title", NULL) == NULL);
+  CHECK(hp_get_elements_by_class_name(root, "nav", links, 4) == 1);
+
+  list = hp_get_element_by_id(root, "list");
+  CHECK(list != NULL);
+  CHECK(hp_get_element_by_id(root, "missing") == NULL);
+  if (!list) return;
+  CHECK(strcmp(hp_node_tag(list), "ul") == 0);
+  CHECK(hp_node_child_count(list) == 2);
+  CHECK(hp_node_child(list, 2) == NULL);
+  CHECK(hp_node_parent(hp_node_child(list, 0)) == list);
+  /* an element has no text of its own, but still a terminated string. */
+  text = hp_node_text(list, &length);
+  CHECK(text != NULL && text[0] == '\0' && length == 0);
+  link = hp_node_child(hp_node_child(list, 0), 0);
+  CHECK(link && hp_node_child_count(link) == 1 && hp_node_is_text(hp_node_child(link, 0)));
+  if (!link || !hp_node_child_count(link)) return;
+  text = hp_node_text(hp_node_child(link, 0), &length);
+  CHECK(length == 3 && strcmp(text, "one") == 0);
+
+  CHECK(hp_select(root, "//ul/li[2]/a", links, 4) == 1);
+  CHECK(hp_select(root, "//li[", links, 4) == (size_t)-1);
+
+  html = hp_node_inner_html(hp_node_child(list, 0), 0);
+  CHECK(html && strcmp(html, "<li><a href=\"/one\">one</a></li>") == 0);
+  hp_string_free(html);
+  html = hp_node_inner_text(list);
+  CHECK(html && strcmp(html, "onetwo") == 0);
+  hp_string_free(html);
+  hp_string_free(NULL);
+}
+
+int main(void) {
+  const char *page =
+    "<html><body><div class=\"nav\"><a href=\"/\">home</a><!-- menu --></div>"
+    "<ul id=\"list\"><li><a href=\"/one\">one</a></li><li><a href=\"/two\">two</a></li></ul>"
+    "</body></html>";
+  char *copy;
+  hp_document *document = hp_document_create();
+  const hp_node *root;
+  hp_limits limits;
+
+  CHECK(hp_abi_version() == HP_ABI_VERSION);
+  CHECK(document != NULL);
+  if (!document) return 1;
+
+  /* copied input */
+  root = hp_parse(document, page, strlen(page), 0, NULL);
+  CHECK(root != NULL && root == hp_document_root(document));
+  CHECK(hp_document_status(document) == HP_STATUS_COMPLETE);
+  if (root) check_queries(root);
+
+  /* borrowed input: the document does not point into the buffer after the parse. */
+  copy = malloc(strlen(page) + 1);
+  strcpy(copy, page);
+  root = hp_parse(document, copy, strlen(copy), HP_PARSE_BORROW, NULL);
+  memset(copy, 'x', strlen(copy));
+  free(copy);
+  CHECK(root != NULL && hp_document_status(document) == HP_STATUS_COMPLETE);
+  if (root) check_queries(root);
+
+  /* limits */
+  memset(&limits, 0, sizeof limits);
+  limits.max_nodes = 3;
+  root = hp_parse(document, page, strlen(page), HP_PARSE_BORROW, &limits);
+  CHECK(root != NULL && hp_document_status(document) == HP_STATUS_NODE_LIMIT);
+
+  hp_document_destroy(document);
+  return failures;
+}
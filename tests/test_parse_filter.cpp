@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "html_parser.hpp"
+#include "check.hpp"
+
+int main() {
+  const char *path = "test_parse_filter.html";
+  {
+    std::ofstream out(path);
+    out << "<html><body class=\"page\">"
+           "<script>var a = '<a href=\"x\">';</script><style>a { color: red }</style>"
+           "<div id=\"menu\" class=\"nav\"><a href=\"/one\">one<!-- first --></a><img src=\"i.png\"></div>"
+           "<p data-keep=\"1\">text<!-- note --></p>"
+           "</body></html>";
+  }
+  html_parser parser;
+
+  // by tag only: rejected elements keep no attributes, even as ancestors of a match.
+  parse_filter links;
+  links.tags = { "a" };
+  const dom_element *document = parser.parse_html(path, links);
+  CHECK(parser.status() == parse_status::complete);
+  CHECK(document->innerHTML() == "<html><body><div><a href=\"/one\">one<!-- first --></a></div></body></html>");
+
+  // without text: neither text nor comments under the match.
+  links.keep_text = false;
+  document = parser.parse_html(path, links);
+  CHECK(document->innerHTML() == "<html><body><div><a href=\"/one\"></a></div></body></html>");
+
+  // by attribute: the attributes are needed to decide, and stay on the ancestors.
+  parse_filter marked;
+  marked.attributes = { "data-keep" };
+  document = parser.parse_html(path, marked);
+  CHECK(document->innerHTML() == "<html><body class=\"page\"><p data-keep=\"1\">text<!-- note --></p></body></html>");
+
+  // a matched script keeps its text, a rejected one is only scanned.
+  parse_filter scripts;
+  scripts.tags = { "script" };
+  document = parser.parse_html(path, scripts);
+  CHECK(document->innerHTML() == "<html><body><script>var a = '<a href=\"x\">';</script></body></html>");
+
+  // the subtree kept as a whole, comments included.
+  parse_filter menu;
+  menu.subtree_id = "menu";
+  document = parser.parse_html(path, menu);
+  const dom_element *kept = document->get_element_by_id("menu");
+  CHECK(kept && kept->has_classname("nav"));
+  CHECK(kept && kept->get_child_nodes().size() == 2);
+  CHECK(document->innerHTML().find("<a href=\"/one\">one<!-- first --></a><img src=\"i.png\" /></div>") != std::string::npos);
+  CHECK(document->get_elements_by_tag_name("p").empty());
+
+  // a predicate sees the attributes.
+  parse_filter images;
+  images.predicate = [](const dom_element &x) { return x.get_attribute_value("src") == "i.png"; };
+  document = parser.parse_html(path, images);
+  CHECK(document->get_elements_by_tag_name("img").size() == 1);
+  CHECK(document->get_elements_by_tag_name("a").empty());
+
+  std::remove(path);
+  return failures;
+}
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <string>
+#include "html_parser.hpp"
+#include "check.hpp"
+
+/**
+ * @brief count the nodes of a tree, text nodes and comments included.
+ * @param x root
+ * @returns node count, the root included
+ */
+static size_t count_nodes(const dom_element *x) {
+  size_t count = 1;
+  for (auto &child: x->get_child_nodes()) {
+    count += count_nodes(child);
+  }
+  return count;
+}
+
+/**
+ * @brief deepest nesting of elements below a node.
+ * @param x root
+ * @returns depth, 0 for a node without element children
+ */
+static size_t element_depth(const dom_element *x) {
+  size_t depth = 0;
+  for (auto &child: x->get_children()) {
+    depth = std::max(depth, element_depth(child) + 1);
+  }
+  return depth;
+}
+
+int main() {
+  html_parser parser;
+  std::string page = "<html><body>";
+  for (int i = 0; i < 200; ++i) {
+    page += "<p class=\"c\">paragraph " + std::to_string(i) + "</p>";
+  }
+  page += "</body></html>";
+
+  // without limits, and with limits the page stays within.
+  parse_limits none;
+  CHECK(parser.parse(page.data(), page.size(), none) != nullptr);
+  CHECK(parser.status() == parse_status::complete);
+  parse_limits loose;
+  loose.max_bytes = page.size() + 1;
+  loose.max_nodes = 1000;
+  loose.with_timeout(std::chrono::hours(1));
+  loose.clock_interval = 16;
+  parser.parse(page.data(), page.size(), loose);
+  CHECK(parser.status() == parse_status::complete);
+
+  const std::string unterminated = "<html><body><p>text<!-- never closed";
+  parser.parse(unterminated.data(), unterminated.size(), none);
+  CHECK(parser.status() == parse_status::unexpected_end);
+
+  parse_limits bytes;
+  bytes.max_bytes = 100;
+  const dom_element *document = parser.parse(page.data(), page.size(), bytes);
+  CHECK(parser.status() == parse_status::byte_limit);
+  CHECK(document && document->innerHTML().size() < page.size() / 4);
+
+  // max_nodes is an upper bound, the document node included.
+  for (uint64_t max_nodes: { 1, 2, 5, 50 }) {
+    parse_limits nodes;
+    nodes.max_nodes = max_nodes;
+    document = parser.parse(page.data(), page.size(), nodes);
+    CHECK(parser.status() == parse_status::node_limit);
+    CHECK(document && count_nodes(document) <= max_nodes);
+  }
+
+  std::string deep;
+  for (int i = 0; i < 100; ++i) deep += "<div>";
+  deep += "x";
+  for (int i = 0; i < 100; ++i) deep += "</div>";
+  parse_limits nesting;
+  nesting.max_depth = 10;
+  document = parser.parse(deep.data(), deep.size(), nesting);
+  CHECK(parser.status() == parse_status::depth_limit);
+  // the element that goes past the limit is kept, without its content.
+  CHECK(document && element_depth(document) == 11);
+  CHECK(document && document->innerHTML().find('x') == std::string::npos);
+
+  std::string attributes = "<html><body><div";
+  for (int i = 0; i < 20; ++i) attributes += " a" + std::to_string(i) + "=\"v\"";
+  attributes += ">x</div></body></html>";
+  parse_limits attribute_count;
+  attribute_count.max_attributes = 5;
+  parser.parse(attributes.data(), attributes.size(), attribute_count);
+  CHECK(parser.status() == parse_status::attribute_limit);
+
+  const std::string long_text = "<html><body><p>" + std::string(1000, 'a') + "</p></body></html>";
+  parse_limits text;
+  text.max_text_length = 100;
+  parser.parse(long_text.data(), long_text.size(), text);
+  CHECK(parser.status() == parse_status::text_limit);
+
+  // a deadline already passed stops the parse at its first look at the clock.
+  parse_limits deadline;
+  deadline.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+  deadline.clock_interval = 16;
+  document = parser.parse(page.data(), page.size(), deadline);
+  CHECK(parser.status() == parse_status::deadline);
+  CHECK(document && count_nodes(document) < 10);
+
+  // the limits and the status of a parse do not carry over to the next one.
+  parser.parse(page.data(), page.size(), none);
+  CHECK(parser.status() == parse_status::complete);
+  return failures;
+}
@@ -0,0 +1,114 @@
+#include <string>
+#include <vector>
+#include "html_parser.hpp"
+#include "check.hpp"
+
+/**
+ * @brief check that each change has the sides its kind says.
+ * @param changes diff to check
+ * @returns void
+ */
+static void check_sides(const std::vector<subtree_hashes::tree_change> &changes) {
+  for (auto &c: changes) {
+    CHECK((c.before != nullptr) == (c.kind != subtree_hashes::change_kind::inserted));
+    CHECK((c.after != nullptr) == (c.kind != subtree_hashes::change_kind::removed));
+  }
+}
+
+/**
+ * @brief markup of a page whose list holds the given items.
+ * @param items content of the li elements
+ * @param title title attribute of the list
+ * @returns markup
+ */
+static std::string page(const std::vector<std::string> &items, const std::string &title = "list") {
+  std::string markup = "<html><body><div id=\"nav\"><a href=\"/\">home</a></div><ul title=\"" + title + "\">";
+  for (auto &item: items) markup += "<li>" + item + "</li>";
+  return markup + "</ul><p>footer</p></body></html>";
+}
+
+int main() {
+  using change_kind = subtree_hashes::change_kind;
+  const std::string base = page({ "one", "two", "three" });
+
+  // the same markup hashes the same in two parses.
+  html_parser first, second;
+  const dom_element *a = first.parse_html_editable(base);
+  const dom_element *b = second.parse_html_editable(base);
+  subtree_hashes hashes;
+  CHECK(a != b && hashes.equals(a, b));
+  CHECK(hashes.diff(a, b).empty());
+  CHECK(!hashes.equals(a->get_element_by_id("nav"), b->get_children().front()));
+
+  html_parser old_parser, new_parser;
+  const dom_element *before = old_parser.parse_html_editable(base);
+
+  const dom_element *after = new_parser.parse_html_editable(page({ "one", "two", "new", "three" }));
+  std::vector<subtree_hashes::tree_change> changes = hashes.diff(before, after);
+  check_sides(changes);
+  CHECK(changes.size() == 1);
+  if (changes.size() == 1) {
+    CHECK(changes[0].kind == change_kind::inserted);
+    CHECK(changes[0].after->innerHTML() == "<li>new</li>");
+  }
+
+  // the next parse reuses the nodes: their entries must go first.
+  hashes.forget(after);
+  after = new_parser.parse_html_editable(page({ "one", "three" }));
+  changes = hashes.diff(before, after);
+  check_sides(changes);
+  CHECK(changes.size() == 1);
+  if (changes.size() == 1) {
+    CHECK(changes[0].kind == change_kind::removed);
+    CHECK(changes[0].before->innerHTML() == "<li>two</li>");
+  }
+
+  // an attribute changed: the element itself, its children are equal.
+  hashes.forget(after);
+  after = new_parser.parse_html_editable(page({ "one", "two", "three" }, "items"));
+  changes = hashes.diff(before, after);
+  check_sides(changes);
+  CHECK(changes.size() == 1);
+  if (changes.size() == 1) {
+    CHECK(changes[0].kind == change_kind::modified);
+    CHECK(changes[0].before->tag_name() == "ul" && changes[0].after->tag_name() == "ul");
+  }
+
+  // a text changed: only the text node, not the elements above it.
+  hashes.forget(after);
+  after = new_parser.parse_html_editable(page({ "one", "2", "three" }));
+  changes = hashes.diff(before, after);
+  check_sides(changes);
+  CHECK(changes.size() == 1);
+  if (changes.size() == 1) {
+    CHECK(changes[0].kind == change_kind::modified);
+    CHECK(changes[0].before->get_text() == "two" && changes[0].after->get_text() == "2");
+  }
+
+  // every kind in one diff, in document order.
+  hashes.forget(after);
+  after = new_parser.parse_html_editable(page({ "zero", "one", "three" }, "items"));
+  changes = hashes.diff(before, after);
+  check_sides(changes);
+  CHECK(changes.size() == 3);
+  if (changes.size() == 3) {
+    CHECK(changes[0].kind == change_kind::modified);
+    CHECK(changes[1].kind == change_kind::inserted && changes[1].after->innerHTML() == "<li>zero</li>");
+    CHECK(changes[2].kind == change_kind::removed && changes[2].before->innerHTML() == "<li>two</li>");
+  }
+
+  // the table kept by the parser follows its edits.
+  html_parser editing;
+  editing.set_subtree_hashing(true);
+  const dom_element *document = editing.parse_html_editable(base);
+  const uint64_t hash = editing.get_subtree_hashes()->hash(document);
+  CHECK(hash == hashes.hash(before));
+  const dom_element *target = editing.apply_edit(editing.source().find("two"), 3, "2");
+  CHECK(target && target->get_parent());
+  html_parser reference;
+  const dom_element *edited = reference.parse_html_editable(editing.source());
+  CHECK(editing.get_subtree_hashes()->hash(document) == subtree_hashes().hash(edited));
+  CHECK(editing.get_subtree_hashes()->hash(document) != hash);
+  CHECK(editing.memory_report().hashes.used > 0);
+  return failures;
+}
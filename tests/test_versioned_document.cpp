@@ -0,0 +1,84 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "html_parser.hpp"
+#include "versioned_document.hpp"
+#include "check.hpp"
+
+int main() {
+  const size_t items = 256;
+  std::string page = "<html><body><ul>";
+  for (size_t i = 0; i < items; ++i) {
+    page += "<li class=\"item\" data-n=\"" + std::to_string(i) + "\" gen=\"0\"><a href=\"/" + std::to_string(i) +
+      "\">item</a></li>";
+  }
+  page += "</ul></body></html>";
+  html_parser parser;
+  const dom_element *document = parser.parse(page.data(), page.size(), parse_limits());
+  const size_t readers = 4;
+  versioned_document shared(document, readers);
+  CHECK(shared.version() == 0);
+
+  using node = versioned_document::node;
+  std::atomic<bool> done(false);
+  std::atomic<size_t> bad(0), reads(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < readers; ++t) {
+    threads.emplace_back([&]() {
+      uint64_t last_version = 0;
+      size_t last_count = items;
+      while (!done.load()) {
+        versioned_document::snapshot snapshot = shared.pin();
+        // a version is published whole: each one sets gen on every item at once.
+        const std::vector<const node *> list = snapshot.get_elements_by_class_name("item");
+        const std::string gen = list.empty() ? "" : list.front()->get_attribute_value("gen");
+        size_t local_bad = 0;
+        for (auto &x: list) {
+          local_bad += x->get_attribute_value("gen") != gen;
+          // read the strings of the nodes, which a premature free would have released.
+          local_bad += x->innerHTML().find("<a href=\"/") == std::string::npos;
+        }
+        // versions only move forward, and removals only shrink the list.
+        local_bad += snapshot.version() < last_version;
+        local_bad += list.size() > last_count;
+        local_bad += shared.version() < snapshot.version();
+        last_version = snapshot.version();
+        last_count = list.size();
+        bad += local_bad;
+        ++reads;
+      }
+    });
+  }
+
+  // writer: alternate a removal and a rewrite of every item.
+  size_t removed = 0, commits = 0;
+  for (size_t step = 1; removed < items / 2; ++step) {
+    const std::string gen = std::to_string(step);
+    const size_t changed = shared.set_attribute_if([](const node &x) { return x.has_classname("item"); }, "gen", gen);
+    CHECK(changed == items - removed);
+    commits += changed > 0;
+    const std::string victim = std::to_string(removed * 2);
+    removed += shared.remove_elements_if([&](const node &x) { return x.get_attribute_value("data-n") == victim; });
+    ++commits;
+    // nothing changes: no version is published.
+    CHECK(shared.set_attribute_if([](const node &x) { return x.has_classname("item"); }, "gen", gen) == 0);
+  }
+  // let the readers see the last version.
+  const size_t seen = reads.load();
+  while (reads.load() < seen + readers * 4) std::this_thread::yield();
+  done = true;
+  for (auto &t: threads) t.join();
+
+  CHECK(bad.load() == 0);
+  CHECK(removed == items / 2);
+  CHECK(shared.version() == commits);
+  versioned_document::snapshot last = shared.pin();
+  CHECK(last.version() == commits);
+  CHECK(last.get_elements_by_class_name("item").size() == items - removed);
+  CHECK(last.get_element_by_id("missing") == nullptr);
+  // with no snapshot older than the current version, everything retired is freed.
+  versioned_document::snapshot moved(std::move(last));
+  CHECK(shared.reclaim() == 0);
+  return failures;
+}
@@ -0,0 +1,100 @@
+#include <string>
+#include <vector>
+#include "html_parser.hpp"
+#include "frozen_document.hpp"
+#include "string_pool.hpp"
+#include "check.hpp"
+
+/**
+ * @brief count the nodes of a tree, text nodes and comments included.
+ * @param x root
+ * @returns node count, the root included
+ */
+static size_t count_nodes(const dom_element *x) {
+  size_t count = 1;
+  for (auto &child: x->get_child_nodes()) {
+    count += count_nodes(child);
+  }
+  return count;
+}
+
+/**
+ * @brief freeze a subtree and check that the copy reads like it.
+ * @param x root of the subtree
+ * @param strings pool to share the long strings in, nullptr for none
+ * @returns void
+ */
+static void check_frozen(const dom_element *x, string_pool *strings) {
+  frozen_document frozen = strings ? x->freeze(*strings) : x->freeze();
+  CHECK(frozen.innerHTML() == x->innerHTML());
+  CHECK(frozen.innerText() == x->innerText());
+  // a moved-from copy is empty and can be assigned to again.
+  frozen_document moved(std::move(frozen));
+  CHECK(frozen.size() == 0);
+  CHECK(moved.innerHTML() == x->innerHTML());
+  frozen = std::move(moved);
+  CHECK(moved.size() == 0 && moved.pooled_strings() == 0);
+  CHECK(frozen.innerHTML() == x->innerHTML());
+}
+
+int main() {
+  const std::string page =
+    "<html>\n"
+    "  <head>\n"
+    "    <title>whitespace</title>\n"
+    "  </head>\n"
+    "  <body>\n"
+    "    <div id=\"first\">\n"
+    "      <p><b>bold</b> <i>italic</i></p>\n"
+    "      <p>a paragraph long enough to be pooled</p>\n"
+    "    </div>\n"
+    "    <pre>\n  kept   as is\n</pre>\n"
+    "    <div id=\"second\">\n"
+    "      <ul>\n"
+    "        <li>one</li>\n"
+    "        <li>two</li>\n"
+    "      </ul>\n"
+    "    </div>\n"
+    "  </body>\n"
+    "</html>\n";
+
+  html_parser collapsing, dropping;
+  collapsing.set_whitespace_mode(whitespace_mode::collapse);
+  dropping.set_whitespace_mode(whitespace_mode::drop);
+  const dom_element *collapsed = collapsing.parse(page.data(), page.size(), parse_limits());
+  const dom_element *dropped = dropping.parse(page.data(), page.size(), parse_limits());
+
+  // drop builds fewer nodes and reads exactly like collapse.
+  CHECK(count_nodes(dropped) < count_nodes(collapsed));
+  CHECK(dropped->innerHTML() == collapsed->innerHTML());
+  CHECK(dropped->innerText() == collapsed->innerText());
+  CHECK(dropped->innerHTML().find("<b>bold</b> <i>italic</i>") != std::string::npos);
+  CHECK(dropped->innerHTML().find("<pre>\n  kept   as is\n</pre>") != std::string::npos);
+
+  // the dropped whitespace comes back as one-space text nodes in the frozen copy.
+  string_pool strings;
+  const frozen_document frozen = dropped->freeze();
+  CHECK(frozen.size() == count_nodes(collapsed));
+  check_frozen(dropped, nullptr);
+  check_frozen(dropped, &strings);
+
+  // every subtree, including those whose root is next to a dropped run:
+  // the run belongs to the parent, not to the frozen copy of the root.
+  const dom_element *first = dropped->get_element_by_id("first");
+  CHECK(first && first->get_child_nodes().size() == 2);
+  if (first && first->get_child_nodes().size()) {
+    const dom_element *paragraph = first->get_child_nodes().front();
+    CHECK(paragraph->freeze().size() == count_nodes(paragraph));
+  }
+  std::vector<const dom_element *> stack(1, dropped);
+  while (stack.size()) {
+    const dom_element *x = stack.back();
+    stack.pop_back();
+    if (x->get_parent()) {
+      check_frozen(x, nullptr);
+      check_frozen(x, &strings);
+    }
+    stack.insert(stack.end(), x->get_child_nodes().begin(), x->get_child_nodes().end());
+  }
+  return failures;
+}